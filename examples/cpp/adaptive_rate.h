@@ -0,0 +1,123 @@
+#ifndef SILERO_ADAPTIVE_RATE_H_
+#define SILERO_ADAPTIVE_RATE_H_
+
+#include <algorithm>
+#include <cstdint>
+
+// How the stride grows once a stream is idle
+enum class rate_backoff_t
+{
+    fixed,       // every stride-th window as soon as idle_windows were below the negative threshold
+    exponential, // every 2nd window, doubling after each further idle_windows, up to stride
+};
+
+// Duty cycle of the model over sustained non-speech. After idle_windows
+// windows in a row below the negative threshold (threshold - 0.15), only every
+// stride-th window is inferred; the others still become the context of the
+// next one and the segmentation sees the last inferred probability again.
+// The first inferred probability at or above the negative threshold returns
+// the stream to full rate.
+struct AdaptiveRatePolicy
+{
+    int idle_windows = 100; // 3.2 s of 32 ms windows
+    int stride = 4;
+    rate_backoff_t backoff = rate_backoff_t::fixed;
+};
+
+struct rate_stats_t
+{
+    int64_t windows = 0;
+    int64_t skipped = 0;
+    int64_t wakeups = 0;     // returns to full rate
+    int current_stride = 1;
+    int max_stride = 1;      // the largest stride used since the policy was set
+};
+
+// Decides which windows the model sees, disabled until a policy is set
+class AdaptiveRate
+{
+public:
+    // True if the model should not see this window
+    bool skip()
+    {
+        stats.windows++;
+        if (stride_ <= 1)
+            return false;
+        if (++phase < stride_) {
+            stats.skipped++;
+            return true;
+        }
+        phase = 0;
+        return false;
+    };
+
+    // The probability of an inferred window against the negative threshold
+    void observe(float prob, float negative_threshold)
+    {
+        if (prob >= negative_threshold) {
+            if (stride_ > 1)
+                stats.wakeups++;
+            idle = 0;
+            set_stride(1);
+            return;
+        }
+        // Idle time counts in windows of audio, skipped ones included
+        idle += stride_;
+        if (idle < policy_.idle_windows)
+            return;
+        if (policy_.backoff == rate_backoff_t::fixed) {
+            set_stride(policy_.stride);
+            return;
+        }
+        int64_t steps = idle / std::max(policy_.idle_windows, 1);
+        int stride = 1;
+        while (steps-- > 0 && stride < policy_.stride)
+            stride *= 2;
+        set_stride(std::min(stride, policy_.stride));
+    };
+
+    void set_policy(const AdaptiveRatePolicy &policy)
+    {
+        policy_ = policy;
+        enabled_ = true;
+        stats = rate_stats_t();
+        reset();
+    };
+
+    void disable()
+    {
+        enabled_ = false;
+        reset();
+    };
+
+    // A new audio starts at full rate, the statistics go on
+    void reset()
+    {
+        idle = 0;
+        phase = 0;
+        stride_ = 1;
+        stats.current_stride = 1;
+    };
+
+    bool enabled() const { return enabled_; };
+    const AdaptiveRatePolicy &policy() const { return policy_; };
+    const rate_stats_t &get_stats() const { return stats; };
+
+private:
+    void set_stride(int stride)
+    {
+        stride_ = std::max(stride, 1);
+        phase = 0;
+        stats.current_stride = stride_;
+        stats.max_stride = std::max(stats.max_stride, stride_);
+    };
+
+    bool enabled_ = false;
+    AdaptiveRatePolicy policy_;
+    int64_t idle = 0;
+    int phase = 0;
+    int stride_ = 1;
+    rate_stats_t stats;
+};
+
+#endif  // SILERO_ADAPTIVE_RATE_H_
@@ -0,0 +1,483 @@
+#ifndef SILERO_BATCHED_VAD_ENGINE_H_
+#define SILERO_BATCHED_VAD_ENGINE_H_
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+#include "vad_iterator.h"
+
+// Runs the windows of many independent streams through one [N, context + window]
+// invoke. Every stream keeps its own VadIterator for the segmentation state
+// machine, its context and its own [2, 1, 128] state, gathered into the
+// [2, N, 128] batch state before each invoke and scattered back out afterwards.
+class BatchedVadEngine
+{
+private:
+    // Infer rows [0, rows) of input/_state into output/_stateN
+    virtual void infer(int rows) = 0;
+
+public:
+    // Admit a new stream, returns its id. Ids of removed streams are reused.
+    int add_stream()
+    {
+        int id;
+        if (!free_ids.empty()) {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+        else {
+            id = static_cast<int>(streams.size());
+            streams.emplace_back();
+            stream_rows.push_back(-1);
+        }
+        streams[id].reset(new VadIterator(prototype));
+        streams[id]->reset_states();
+        streams[id]->events.clear();
+        stream_rows[id] = -1;
+        return id;
+    };
+
+    // Evict a stream, a window still queued for it is inferred first
+    void remove_stream(int id)
+    {
+        if (stream_rows[id] >= 0)
+            run();
+        streams[id].reset();
+        free_ids.push_back(id);
+    };
+
+    // Queue one window (window_size_samples) of a stream for the next invoke.
+    // The batch is run first if it is full or already holds a window of this stream.
+    void push_window(int id, const float *data)
+    {
+        float *window = queue_window(id);
+        VAD_STAGE(stage_timers, stage_input);
+        std::memcpy(window, data, window_size_samples * sizeof(float));
+    };
+
+    // Same as push_window, but returns the batch row the window_size_samples
+    // of the window are to be written to before the next run(), so readers
+    // can convert straight into it
+    float *queue_window(int id)
+    {
+        if (stream_rows[id] >= 0 || static_cast<int>(batch_ids.size()) == max_batch)
+            run();
+
+        // Row is [context | window], run() hands the tail to the stream as its next context
+        int row = static_cast<int>(batch_ids.size());
+        float *dst = &input[row * (context_samples + window_size_samples)];
+        std::memcpy(dst, streams[id]->input_buffer(), context_samples * sizeof(float));
+        stream_rows[id] = row;
+        batch_ids.push_back(id);
+        return dst + context_samples;
+    };
+
+    // Every channel of a multichannel reader (e.g. agent and customer of a
+    // call) as a stream of its own: each window of all channels is split from
+    // the interleaved PCM straight into the batch rows by
+    // reader.ReadChannels(offset, count, dst) (wav::MappedWavReader), and
+    // inferred in one invoke when max_batch allows. Returns the speeches of
+    // each channel.
+    template <typename Reader>
+    std::vector<std::vector<timestamp_t>> process_channels(const Reader &reader)
+    {
+        const int channels = reader.num_channel();
+        const int64_t audio_length = reader.num_samples();
+        std::vector<int> ids;
+        for (int c = 0; c < channels; c++)
+            ids.push_back(add_stream());
+        std::vector<float *> rows(channels, nullptr);
+        for (int64_t offset = 0; offset + window_size_samples <= audio_length; offset += window_size_samples) {
+            // Channels in groups of max_batch, each group's rows reserved before it is read
+            for (int first = 0; first < channels; first += max_batch) {
+                int last = std::min(channels, first + max_batch);
+                if (!batch_ids.empty() && static_cast<int>(batch_ids.size()) + last - first > max_batch)
+                    run();
+                std::fill(rows.begin(), rows.end(), nullptr);
+                for (int c = first; c < last; c++)
+                    rows[c] = queue_window(ids[c]);
+                VAD_STAGE(stage_timers, stage_input);
+                reader.ReadChannels(offset, window_size_samples, rows.data());
+            }
+        }
+        std::vector<std::vector<timestamp_t>> speeches(channels);
+        for (int c = 0; c < channels; c++) {
+            finish_stream(ids[c], audio_length);
+            speeches[c] = get_speech_timestamps(ids[c]);
+            remove_stream(ids[c]);
+        }
+        return speeches;
+    };
+
+    // Infer all queued windows in one invoke, returns the number of windows processed
+    int run()
+    {
+        int batch = static_cast<int>(batch_ids.size());
+        if (batch == 0)
+            return 0;
+
+        // Stages are timed per batch here, segment also per window in every stream
+        VAD_STAGE(stage_timers, stage_window);
+
+        // state is [2, rows, 128]: both halves of a stream state go to its row,
+        // and the tail of its window becomes its next context
+        int rows = static_batch ? max_batch : batch;
+        {
+            VAD_STAGE(stage_timers, stage_state);
+            for (int r = 0; r < batch; r++) {
+                const float *row = &input[r * (context_samples + window_size_samples)];
+                std::memcpy(streams[batch_ids[r]]->input_buffer(), row + window_size_samples,
+                    context_samples * sizeof(float));
+                const float *state = streams[batch_ids[r]]->_state.data();
+                std::memcpy(&_state[r * state_size], state, state_size * sizeof(float));
+                std::memcpy(&_state[(rows + r) * state_size], state + state_size, state_size * sizeof(float));
+            }
+        }
+
+        infer(rows);
+
+        {
+            VAD_STAGE(stage_timers, stage_state);
+            for (int r = 0; r < batch; r++) {
+                float *state = streams[batch_ids[r]]->_state.data();
+                std::memcpy(state, &_stateN[r * state_size], state_size * sizeof(float));
+                std::memcpy(state + state_size, &_stateN[(rows + r) * state_size], state_size * sizeof(float));
+            }
+        }
+
+        VAD_STAGE(stage_timers, stage_segment);
+        for (int r = 0; r < batch; r++) {
+            VadIterator &stream = *streams[batch_ids[r]];
+            stream_rows[batch_ids[r]] = -1;
+            size_t ended = stream.speeches.size();
+            int64_t started = stream.current_speech.start;
+            stream.segment(output[r]);
+            stream.add_events(ended, started);
+        }
+        batch_ids.clear();
+        return batch;
+    };
+
+    // End of a stream's audio: infer its queued window and close any open speech,
+    // at audio_length if given (samples after the last whole window count) or
+    // else at the end of the last window.
+    void finish_stream(int id, int64_t audio_length = -1)
+    {
+        if (stream_rows[id] >= 0)
+            run();
+        VadIterator &stream = *streams[id];
+        size_t ended = stream.speeches.size();
+        stream.finish(audio_length >= 0 ? audio_length : stream.current_sample);
+        stream.add_events(ended, stream.current_speech.start);
+    };
+
+    // Start a new audio on a stream (zero state and context, no timestamps) without
+    // giving up its id, e.g. the next file of a packed row
+    void reset_stream(int id)
+    {
+        if (stream_rows[id] >= 0)
+            run();
+        streams[id]->reset_states();
+        streams[id]->events.clear();
+    };
+
+    // Moves the speech starts/ends decided for a stream since the last call to
+    // the end of out, as VadIterator::push would have returned them
+    void take_events(int id, std::vector<vad_event_t> &out)
+    {
+        std::vector<vad_event_t> &events = streams[id]->events;
+        out.insert(out.end(), events.begin(), events.end());
+        events.clear();
+    };
+
+    // Samples a stream has had inferred, i.e. where its events were decided
+    int64_t stream_samples(int id) const
+    {
+        return streams[id]->current_sample;
+    };
+
+    const std::vector<timestamp_t> get_speech_timestamps(int id) const
+    {
+        return streams[id]->get_speech_timestamps();
+    };
+
+    // Keep the probabilities of a stream in track (nullptr stops), see VadIterator::record
+    void record(int id, ProbTrack *track)
+    {
+        streams[id]->record(track);
+    };
+
+    // Timestamps of a probability track under the engine's segmentation parameters
+    std::vector<timestamp_t> segment_track(const ProbTrack &track) const
+    {
+        VadIterator segmenter(prototype);
+        segmenter.process(track);
+        return segmenter.get_speech_timestamps();
+    };
+
+    int max_batch_size() const
+    {
+        return max_batch;
+    };
+
+    int num_streams() const
+    {
+        return static_cast<int>(streams.size() - free_ids.size());
+    };
+
+    int64_t window_samples() const
+    {
+        return window_size_samples;
+    };
+
+    int sample_rate() const
+    {
+        return prototype.sample_rate;
+    };
+
+#if defined VAD_STAGE_TIMERS
+    // Latency of each stage per batched invoke, input per pushed window
+    const StageTimers& get_stage_timers() const
+    {
+        return stage_timers;
+    };
+
+    StageTimers& get_stage_timers()
+    {
+        return stage_timers;
+    };
+#endif
+
+protected:
+    // For models exported without the context input (0), before any stream is added
+    void set_context_samples(int samples)
+    {
+        context_samples = samples;
+        prototype.set_context_samples(samples);
+        input.assign(max_batch * (context_samples + window_size_samples), 0.0f);
+    };
+
+    int max_batch;
+    int64_t window_size_samples;
+    int64_t context_samples;
+    bool static_batch = false; // backend always invokes max_batch rows
+    const int state_size = 128;
+
+    // Template for the segmentation parameters of every stream
+    VadIterator prototype;
+    std::vector<std::unique_ptr<VadIterator>> streams; // nullptr for removed streams
+    std::vector<int> stream_rows; // batch row of the queued window, -1 if none
+    std::vector<int> free_ids;
+    std::vector<int> batch_ids; // stream of each queued row
+#if defined VAD_STAGE_TIMERS
+    StageTimers stage_timers;
+#endif
+
+    std::vector<const char *> input_node_names = {"input", "state", "sr"};
+    std::vector<const char *> output_node_names = {"output", "stateN"};
+    std::vector<float> input;   // [max_batch, context + window]
+    std::vector<float> _state;  // [2, rows, 128]
+    std::vector<int64_t> sr;
+    std::vector<float> output;  // [max_batch, 1]
+    std::vector<float> _stateN; // [2, rows, 128]
+
+public:
+    // Construction
+    BatchedVadEngine(int Max_batch, int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity())
+        : max_batch(Max_batch),
+          prototype(Sample_rate, windows_frame_size, Threshold, min_silence_duration_ms,
+            speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        if (max_batch <= 0)
+            throw std::invalid_argument("max_batch must be positive");
+        window_size_samples = windows_frame_size * (Sample_rate / 1000);
+        context_samples = prototype.context_samples;
+        input.resize(max_batch * (context_samples + window_size_samples));
+        _state.resize(2 * max_batch * state_size);
+        _stateN.resize(2 * max_batch * state_size);
+        output.resize(max_batch);
+        sr.resize(1);
+        sr[0] = Sample_rate;
+        batch_ids.reserve(max_batch);
+    };
+
+    virtual ~BatchedVadEngine() = default;
+};
+
+#if defined ONNX
+
+class OnnxBatchedVadEngine: public BatchedVadEngine
+{
+private:
+    std::shared_ptr<OnnxVadModel> model;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+    Ort::RunOptions run_options{nullptr};
+
+    void infer(int rows)
+    {
+        // The buffers are persistent, only the shapes change with the batch size
+        const int64_t row_samples = context_samples + window_size_samples;
+        const int64_t input_dims[2] = {rows, row_samples};
+        const int64_t state_dims[3] = {2, rows, state_size};
+        const int64_t sr_dims[1] = {1};
+        const int64_t output_dims[2] = {rows, 1};
+
+        // The values must outlive Run, only their creation is the tensor stage
+        Ort::Value inputs[3] = {Ort::Value(nullptr), Ort::Value(nullptr), Ort::Value(nullptr)};
+        Ort::Value outputs[2] = {Ort::Value(nullptr), Ort::Value(nullptr)};
+        {
+            VAD_STAGE(stage_timers, stage_tensor);
+            inputs[0] = Ort::Value::CreateTensor<float>(memory_info, input.data(), rows * row_samples, input_dims, 2);
+            inputs[1] = Ort::Value::CreateTensor<float>(memory_info, _state.data(), 2 * rows * state_size, state_dims, 3);
+            inputs[2] = Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(), sr.size(), sr_dims, 1);
+            outputs[0] = Ort::Value::CreateTensor<float>(memory_info, output.data(), rows, output_dims, 2);
+            outputs[1] = Ort::Value::CreateTensor<float>(memory_info, _stateN.data(), 2 * rows * state_size, state_dims, 3);
+        }
+
+        {
+            VAD_STAGE(stage_timers, stage_infer);
+            model->session().Run(run_options,
+                input_node_names.data(), inputs, model->takes_sample_rate() ? 3 : 2,
+                output_node_names.data(), outputs, 2);
+        }
+    };
+
+public:
+    // Construction
+    OnnxBatchedVadEngine(std::shared_ptr<OnnxVadModel> Model, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): BatchedVadEngine(Max_batch, Sample_rate,
+        windows_frame_size, Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s),
+        model(Model)
+    {
+        model->check_sample_rate(Sample_rate);
+    }
+
+    OnnxBatchedVadEngine(const std::string ModelPath, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): OnnxBatchedVadEngine(
+        std::make_shared<OnnxVadModel>(ModelPath), Max_batch, Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+    }
+};
+#elif !defined NATIVE
+// kmodels are compiled for a fixed batch, so Max_batch must match it and every
+// invoke runs all rows; rows without a queued window are simply ignored.
+class NncaseBatchedVadEngine: public BatchedVadEngine
+{
+private:
+    nncase::runtime::runtime_tensor create_tensor(size_t index, std::initializer_list<size_t> dims)
+    {
+        auto type = entry_function_->parameter_type(index).expect("parameter type out of index");
+        auto ts_type = type.as<nncase::tensor_type>().expect("input is not a tensor type");
+        nncase::dims_t shape(dims.begin(), dims.end());
+        return nncase::runtime::host_runtime_tensor::create(ts_type->dtype()->typecode(), shape, nncase::runtime::host_runtime_tensor::pool_shared).expect("cannot create tensor");
+    }
+
+    void init_model(std::shared_ptr<NncaseVadModel> Model)
+    {
+        model_ = Model;
+        interpreter_.load_model(model_->buffer(), false).unwrap_or_throw();
+        entry_function_ = interpreter_.entry_function().unwrap_or_throw();
+
+        // kmodels compiled from the bare window have no room for the context
+        auto type = entry_function_->parameter_type(0).expect("parameter type out of index");
+        const nncase::shape_t &shape = type.as<nncase::tensor_type>().expect("input is not a tensor type")->shape();
+        if (shape.is_fixed() && !shape.dims().empty() && shape.back().fixed_value() == window_size_samples)
+            set_context_samples(0);
+
+        size_t rows = static_cast<size_t>(max_batch);
+        input_tensor_ = create_tensor(0, { rows, static_cast<size_t>(context_samples + window_size_samples) });
+        state_tensor_ = create_tensor(1, { 2, rows, static_cast<size_t>(state_size) });
+        sr_tensor_ = create_tensor(2, { 1 });
+        {
+            auto sr_mapped = nncase::runtime::hrt::map(sr_tensor_, nncase::runtime::map_write).unwrap_or_throw();
+            sr_mapped.buffer().as_span<int64_t>().data()[0] = sr[0];
+        }
+        nncase::runtime::hrt::sync(sr_tensor_, nncase::runtime::sync_write_back, true).unwrap_or_throw();
+        inputs_ = { input_tensor_.impl(), state_tensor_.impl(), sr_tensor_.impl() };
+    };
+
+    void write_tensor(nncase::runtime::runtime_tensor &tensor, const float *data, size_t count)
+    {
+        {
+            auto mapped = nncase::runtime::hrt::map(tensor, nncase::runtime::map_write).unwrap_or_throw();
+            std::memcpy(mapped.buffer().as_span<float>().data(), data, count * sizeof(float));
+        }
+        nncase::runtime::hrt::sync(tensor, nncase::runtime::sync_write_back, true).unwrap_or_throw();
+    }
+
+    void read_field(nncase::tuple &outputs, size_t index, float *data, size_t count)
+    {
+        auto tensor = outputs->fields()[index].as<nncase::tensor>().unwrap_or_throw();
+        auto buffer = tensor->buffer().as_host().unwrap_or_throw();
+        auto mapped = buffer.map(nncase::runtime::map_read).unwrap_or_throw();
+        std::memcpy(data, mapped.buffer().as_span<float>().data(), count * sizeof(float));
+    }
+
+    void infer(int rows)
+    {
+        {
+            VAD_STAGE(stage_timers, stage_tensor);
+            write_tensor(input_tensor_, input.data(), rows * (context_samples + window_size_samples));
+            write_tensor(state_tensor_, _state.data(), 2 * rows * state_size);
+        }
+
+        nncase::tuple outputs;
+        {
+            VAD_STAGE(stage_timers, stage_infer);
+            outputs = entry_function_->invoke(inputs_).unwrap_or_throw().as<nncase::tuple>().unwrap_or_throw();
+        }
+        VAD_STAGE(stage_timers, stage_tensor);
+        read_field(outputs, 0, output.data(), rows);
+        read_field(outputs, 1, _stateN.data(), 2 * rows * state_size);
+    };
+
+private:
+    std::shared_ptr<NncaseVadModel> model_;
+    nncase::runtime::interpreter interpreter_;
+    nncase::runtime::runtime_function *entry_function_;
+    nncase::runtime::runtime_tensor input_tensor_;
+    nncase::runtime::runtime_tensor state_tensor_;
+    nncase::runtime::runtime_tensor sr_tensor_;
+    std::vector<nncase::value_t> inputs_;
+
+public:
+    // Construction
+    NncaseBatchedVadEngine(std::shared_ptr<NncaseVadModel> Model, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): BatchedVadEngine(Max_batch, Sample_rate,
+        windows_frame_size, Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        static_batch = true;
+        init_model(Model);
+    }
+
+    NncaseBatchedVadEngine(const std::string ModelPath, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): NncaseBatchedVadEngine(
+        std::make_shared<NncaseVadModel>(ModelPath), Max_batch, Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+    }
+};
+#endif
+
+#endif  // SILERO_BATCHED_VAD_ENGINE_H_
@@ -0,0 +1,229 @@
+#ifndef SILERO_BENCH_SUITE_H_
+#define SILERO_BENCH_SUITE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Shared by the benchmark suite runners of every backend (vad_bench suite and
+// the libtorch bench), so their JSON lines can be compared and tracked across
+// versions. Include it in exactly one translation unit of a binary: on glibc
+// it replaces malloc and friends to count the allocations of the whole
+// process, runtimes included.
+namespace bench
+{
+
+static std::atomic<uint64_t> alloc_count{0};
+static std::atomic<uint64_t> alloc_bytes{0};
+
+inline void count_alloc(size_t bytes)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace bench
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+// The blocks still come from the glibc heap, only counted on the way, so
+// memory from functions left alone (valloc, ...) is freed the same way
+void *malloc(size_t size)
+{
+    bench::count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    bench::count_alloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    bench::count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    bench::count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    bench::count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+        return 22; // EINVAL
+    bench::count_alloc(size);
+    void *block = __libc_memalign(alignment, size);
+    if (!block)
+        return 12; // ENOMEM
+    *ptr = block;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+}
+#define BENCH_COUNTS_ALLOCATIONS 1
+#else
+#define BENCH_COUNTS_ALLOCATIONS 0
+#endif
+
+// Revision the numbers belong to, set by the build (git describe)
+#ifndef VAD_BENCH_VERSION
+#define VAD_BENCH_VERSION "unknown"
+#endif
+
+namespace bench
+{
+
+// Deterministic speech-like test signal: voiced bursts of 0.4-2 s (harmonics
+// of a gliding 100-250 Hz pitch, syllable-rate envelope, a little noise)
+// between pauses of 0.2-1.5 s of faint noise, the same for every run at a rate.
+inline std::vector<float> synthetic_audio(int sample_rate, double seconds)
+{
+    std::vector<float> audio(static_cast<size_t>(seconds * sample_rate));
+    uint32_t seed = 12345;
+    auto uniform = [&]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0 / 16777216.0);
+    };
+    const double pi = 3.14159265358979323846;
+    size_t i = 0;
+    bool voiced = false;
+    while (i < audio.size()) {
+        size_t length = static_cast<size_t>((voiced ? 0.4 + 1.6 * uniform() : 0.2 + 1.3 * uniform()) * sample_rate);
+        length = std::min(length, audio.size() - i);
+        double f0 = 100 + 150 * uniform();
+        double glide = (uniform() - 0.5) * 60;
+        double phase = 0;
+        for (size_t n = 0; n < length; n++) {
+            double t = static_cast<double>(n) / sample_rate;
+            double noise = uniform() - 0.5;
+            if (!voiced) {
+                audio[i + n] = static_cast<float>(0.002 * noise);
+                continue;
+            }
+            phase += 2 * pi * (f0 + glide * t / (static_cast<double>(length) / sample_rate)) / sample_rate;
+            double voice = 0;
+            for (int h = 1; h <= 12 && h * (f0 + 30) < sample_rate / 2; h++)
+                voice += std::sin(h * phase) / h;
+            double envelope = 0.55 + 0.45 * std::sin(2 * pi * 4.0 * t);
+            double edge = std::min(1.0, std::min(n, length - n) / (0.02 * sample_rate));
+            audio[i + n] = static_cast<float>(0.25 * edge * envelope * voice + 0.01 * noise);
+        }
+        i += length;
+        voiced = !voiced;
+    }
+    return audio;
+}
+
+// One backend / model / rate / input measurement, per_window_us holds the
+// latency of every timed window
+struct suite_result_t
+{
+    std::string backend;
+    std::string model;
+    int sample_rate = 0;
+    std::string input;
+    int64_t window_samples = 0;
+    std::vector<double> per_window_us;
+    double audio_s = 0;
+    uint64_t allocs = 0;
+    uint64_t alloc_bytes = 0;
+    int64_t speeches = 0;
+    std::string skipped; // the model does not run this combination
+    std::string error;
+};
+
+inline std::string json_escape(const std::string &text)
+{
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+            out += ' ';
+        else
+            out += c;
+    }
+    return out;
+}
+
+// JSON line: p50/p99/max/mean per window in us, real-time factor (time spent
+// in windows / audio time), heap allocations and bytes per window (-1 where
+// they cannot be counted), and the speeches found as a sanity check
+inline std::string format(suite_result_t result)
+{
+    std::ostringstream line;
+    line << "{\"version\":\"" << json_escape(VAD_BENCH_VERSION) << "\",\"backend\":\"" << json_escape(result.backend) << "\",\"model\":\"" << json_escape(result.model)
+         << "\",\"sample_rate\":" << result.sample_rate << ",\"input\":\"" << json_escape(result.input) << "\"";
+    if (!result.skipped.empty() || !result.error.empty()) {
+        line << (result.error.empty() ? ",\"skipped\":\"" : ",\"error\":\"")
+             << json_escape(result.error.empty() ? result.skipped : result.error) << "\"}";
+        return line.str();
+    }
+    std::vector<double> &us = result.per_window_us;
+    std::sort(us.begin(), us.end());
+    auto at = [&](double q) { return us.empty() ? 0.0 : us[static_cast<size_t>(q * (us.size() - 1))]; };
+    double total = 0;
+    for (double value : us)
+        total += value;
+    double windows = static_cast<double>(std::max<size_t>(us.size(), 1));
+    line << ",\"window_samples\":" << result.window_samples << ",\"windows\":" << us.size()
+         << ",\"p50_us\":" << at(0.5) << ",\"p99_us\":" << at(0.99) << ",\"max_us\":" << at(1.0)
+         << ",\"mean_us\":" << total / windows
+         << ",\"rtf\":" << (result.audio_s > 0 ? total * 1e-6 / result.audio_s : 0.0);
+    if (BENCH_COUNTS_ALLOCATIONS)
+        line << ",\"allocs_per_window\":" << result.allocs / windows << ",\"bytes_per_window\":" << result.alloc_bytes / windows;
+    else
+        line << ",\"allocs_per_window\":-1,\"bytes_per_window\":-1";
+    line << ",\"speeches\":" << result.speeches << "}";
+    return line.str();
+}
+
+// Base name of a path, for the model field
+inline std::string base_name(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Splits a comma separated list
+inline std::vector<std::string> split_list(const std::string &list)
+{
+    std::vector<std::string> items;
+    for (size_t pos = 0; pos <= list.size();) {
+        size_t next = std::min(list.find(',', pos), list.size());
+        if (next > pos)
+            items.push_back(list.substr(pos, next - pos));
+        pos = next + 1;
+    }
+    return items;
+}
+
+}  // namespace bench
+
+#endif  // SILERO_BENCH_SUITE_H_
@@ -0,0 +1,184 @@
+#ifndef SILERO_ENERGY_GATE_H_
+#define SILERO_ENERGY_GATE_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Mean square and zero crossings per sample of one window
+struct window_energy_t
+{
+    float energy;
+    float zcr;
+};
+
+namespace energy {
+
+inline window_energy_t measure_scalar(const float *x, size_t count)
+{
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    size_t crossings = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int k = 0; k < 4; k++)
+            acc[k] += x[i + k] * x[i + k];
+    }
+    for (; i < count; i++)
+        acc[0] += x[i] * x[i];
+    for (i = 1; i < count; i++)
+        crossings += std::signbit(x[i]) != std::signbit(x[i - 1]);
+    float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    return { count ? sum / count : 0.0f, count ? static_cast<float>(crossings) / count : 0.0f };
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Squares accumulate with fma, crossings are the sign bits of x[i] ^ x[i - 1]
+__attribute__((target("avx2,fma,popcnt")))
+inline window_energy_t measure_avx2(const float *x, size_t count)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t crossings = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_loadu_ps(x + i);
+        __m256 b = _mm256_loadu_ps(x + i + 8);
+        acc0 = _mm256_fmadd_ps(a, a, acc0);
+        acc1 = _mm256_fmadd_ps(b, b, acc1);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    float sum = _mm_cvtss_f32(s);
+    for (; i < count; i++)
+        sum += x[i] * x[i];
+
+    size_t j = 1;
+    for (; j + 8 <= count; j += 8) {
+        int signs = _mm256_movemask_ps(_mm256_xor_ps(_mm256_loadu_ps(x + j), _mm256_loadu_ps(x + j - 1)));
+        crossings += _mm_popcnt_u32(static_cast<unsigned>(signs));
+    }
+    for (; j < count; j++)
+        crossings += std::signbit(x[j]) != std::signbit(x[j - 1]);
+    return { count ? sum / count : 0.0f, count ? static_cast<float>(crossings) / count : 0.0f };
+}
+#endif
+
+typedef window_energy_t (*measure_fn)(const float *x, size_t count);
+
+// Kernel for this cpu, picked once
+inline measure_fn select_measure()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("popcnt"))
+        return measure_avx2;
+#endif
+    return measure_scalar;
+}
+
+inline window_energy_t measure(const float *x, size_t count)
+{
+    static const measure_fn kernel = select_measure();
+    return kernel(x, count);
+}
+
+} // namespace energy
+
+// What the lstm state does over windows the gate skips
+enum class gate_state_t
+{
+    hold,    // kept as it was after the last inferred window
+    decay,   // scaled by decay per skipped window, towards the zero state of a fresh stream
+    refresh, // kept, but every refresh_windows-th window of a quiet run is inferred anyway
+};
+
+// Which windows skip the model. A window is quiet below floor_db (RMS, dBFS),
+// or below noise_db when it crosses zero at least noise_zcr times per sample
+// (comfort noise, hiss). Quiet windows are only skipped once the model itself
+// gave a probability below confirm_prob (the end-of-speech level of the
+// default threshold), and not the first hangover_windows after a loud one,
+// so the tail of a speech the model still hears is not cut.
+struct EnergyGatePolicy
+{
+    float floor_db = -60.0f;
+    float noise_db = -45.0f;
+    float noise_zcr = 0.3f;
+    float confirm_prob = 0.35f;
+    int hangover_windows = 2;
+    gate_state_t state = gate_state_t::decay;
+    float decay = 0.9f;
+    int refresh_windows = 16;
+    float skipped_prob = 0.0f; // what the segmentation sees for a skipped window
+};
+
+struct gate_stats_t
+{
+    int64_t windows = 0;
+    int64_t skipped = 0;
+    int64_t refreshed = 0; // quiet windows inferred by the refresh policy
+};
+
+// Energy / zero-crossing pre-gate in front of the model, disabled until a
+// policy is set. Keeps the length of the current quiet run.
+class EnergyGate
+{
+public:
+    // True if the model should not see this window, last_prob being the
+    // probability the segmentation saw for the window before
+    bool skip(const float *window, size_t count, float last_prob)
+    {
+        stats.windows++;
+        window_energy_t measured = energy::measure(window, count);
+        float db = 10.0f * std::log10(measured.energy + 1e-20f);
+        bool quiet = db < policy_.floor_db || (db < policy_.noise_db && measured.zcr >= policy_.noise_zcr);
+        if (!quiet) {
+            quiet_run = 0;
+            return false;
+        }
+        int64_t gated = ++quiet_run - policy_.hangover_windows;
+        if (gated <= 0 || last_prob >= policy_.confirm_prob)
+            return false;
+        if (policy_.state == gate_state_t::refresh && policy_.refresh_windows > 0 && gated % policy_.refresh_windows == 0) {
+            stats.refreshed++;
+            return false;
+        }
+        stats.skipped++;
+        return true;
+    };
+
+    void set_policy(const EnergyGatePolicy &policy)
+    {
+        policy_ = policy;
+        enabled_ = true;
+        quiet_run = 0;
+        stats = gate_stats_t();
+    };
+
+    void disable()
+    {
+        enabled_ = false;
+    };
+
+    // A new audio starts, the statistics go on
+    void reset()
+    {
+        quiet_run = 0;
+    };
+
+    bool enabled() const { return enabled_; };
+    const EnergyGatePolicy &policy() const { return policy_; };
+    const gate_stats_t &get_stats() const { return stats; };
+
+private:
+    bool enabled_ = false;
+    EnergyGatePolicy policy_;
+    int64_t quiet_run = 0;
+    gate_stats_t stats;
+};
+
+#endif  // SILERO_ENERGY_GATE_H_
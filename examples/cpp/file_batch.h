@@ -0,0 +1,523 @@
+#ifndef SILERO_FILE_BATCH_H_
+#define SILERO_FILE_BATCH_H_
+
+#include <glob.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "wav.h"
+#include "vad_iterator.h"
+#include "batched_vad_engine.h"
+
+// Files of a batch: spec is either a glob pattern ("calls/*.wav") or a
+// manifest with one path per line ("-" for stdin), blank lines and lines
+// starting with '#' are skipped.
+inline std::vector<std::string> read_manifest(const std::string &spec)
+{
+    std::vector<std::string> files;
+    if (spec.find_first_of("*?[") != std::string::npos) {
+        glob_t matches;
+        int ret = glob(spec.c_str(), 0, nullptr, &matches);
+        if (ret != 0 && ret != GLOB_NOMATCH)
+            throw std::runtime_error("cannot expand " + spec);
+        for (size_t i = 0; ret == 0 && i < matches.gl_pathc; i++)
+            files.push_back(matches.gl_pathv[i]);
+        globfree(&matches);
+        return files;
+    }
+
+    std::ifstream ifs;
+    if (spec != "-") {
+        ifs.open(spec);
+        if (!ifs)
+            throw std::runtime_error("cannot open " + spec);
+    }
+    std::istream &in = spec == "-" ? std::cin : ifs;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t end = line.find_last_not_of(" \t\r");
+        if (end == std::string::npos || line[0] == '#')
+            continue;
+        files.push_back(line.substr(0, end + 1));
+    }
+    return files;
+}
+
+// Thread pool for many small independent tasks of uneven cost. Every worker
+// owns a contiguous range of task indices and takes from its front; a worker
+// that runs dry steals the back half of another worker's range. Ranges keep
+// the queues O(1) in size however many tasks there are, and the contiguous
+// split keeps neighbouring files (often alike) on the same worker.
+class WorkStealingPool
+{
+public:
+    // Runs task(worker, index) for every index in [0, count), returns when all are done
+    template <typename Task>
+    void run(int64_t count, Task task)
+    {
+        const int workers = static_cast<int>(std::max<int64_t>(1, std::min<int64_t>(num_threads, count)));
+        std::vector<queue_t> queues(workers);
+        for (int w = 0; w < workers; w++) {
+            queues[w].begin = count * w / workers;
+            queues[w].end = count * (w + 1) / workers;
+        }
+
+        auto worker = [&](int w) {
+            int64_t index;
+            while (next(queues, w, index))
+                task(w, index);
+        };
+        std::vector<std::thread> threads;
+        for (int w = 1; w < workers; w++)
+            threads.emplace_back(worker, w);
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+    };
+
+    int size() const
+    {
+        return num_threads;
+    };
+
+private:
+    struct alignas(64) queue_t
+    {
+        std::mutex lock;
+        int64_t begin = 0;
+        int64_t end = 0;
+    };
+
+    // Never holds two locks at once. Stolen work is in flight between the two
+    // locks, which is fine as no task is ever added back.
+    static bool next(std::vector<queue_t> &queues, int w, int64_t &index)
+    {
+        {
+            std::lock_guard<std::mutex> guard(queues[w].lock);
+            if (queues[w].begin < queues[w].end) {
+                index = queues[w].begin++;
+                return true;
+            }
+        }
+
+        const int workers = static_cast<int>(queues.size());
+        for (int i = 1; i < workers; i++) {
+            queue_t &victim = queues[(w + i) % workers];
+            int64_t begin, end;
+            {
+                std::lock_guard<std::mutex> guard(victim.lock);
+                int64_t remaining = victim.end - victim.begin;
+                if (remaining <= 0)
+                    continue;
+                end = victim.end;
+                begin = end - (remaining + 1) / 2;
+                victim.end = begin;
+            }
+            std::lock_guard<std::mutex> guard(queues[w].lock);
+            index = begin;
+            queues[w].begin = begin + 1;
+            queues[w].end = end;
+            return true;
+        }
+        return false;
+    };
+
+    int num_threads;
+
+public:
+    // Construction, Threads 0 means one per core
+    explicit WorkStealingPool(int Threads = 0)
+        : num_threads(Threads > 0 ? Threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency())))
+    {
+    };
+};
+
+// Aggregate of one batch run
+struct batch_stats_t
+{
+    int64_t files = 0;
+    int64_t failed = 0;
+    double audio_seconds = 0;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    std::vector<double> latencies; // seconds per successful file, sorted
+
+    // Latency at quantile q in [0, 1]
+    double latency(double q) const
+    {
+        if (latencies.empty())
+            return 0;
+        size_t i = static_cast<size_t>(q * (latencies.size() - 1) + 0.5);
+        return latencies[std::min(i, latencies.size() - 1)];
+    };
+
+    // Accumulates one worker's share
+    void add(const batch_stats_t &worker)
+    {
+        files += worker.files;
+        failed += worker.failed;
+        audio_seconds += worker.audio_seconds;
+        latencies.insert(latencies.end(), worker.latencies.begin(), worker.latencies.end());
+    };
+};
+
+// Result lines of a batch, one JSON object per file in completion order:
+//   {"file":"a.wav","sample_rate":16000,"duration_s":3.2,"latency_ms":1.4,"speeches":[[start,end],...]}
+//   {"file":"b.wav","error":"..."}
+// Workers format into their own line and the writer appends it under a lock,
+// flushing every flush_lines so a crash loses at most that many results.
+class BatchResultWriter
+{
+public:
+    static void format(std::string &line, const std::string &file, int sample_rate, double duration,
+        double latency, const std::vector<timestamp_t> &speeches)
+    {
+        line += "{\"file\":";
+        append_string(line, file);
+        char buf[128];
+        snprintf(buf, sizeof(buf), ",\"sample_rate\":%d,\"duration_s\":%.3f,\"latency_ms\":%.3f,\"speeches\":[",
+            sample_rate, duration, latency * 1e3);
+        line += buf;
+        for (size_t i = 0; i < speeches.size(); i++) {
+            snprintf(buf, sizeof(buf), "%s[%" PRId64 ",%" PRId64 "]", i ? "," : "", speeches[i].start, speeches[i].end);
+            line += buf;
+        }
+        line += "]}\n";
+    };
+
+    static void format_error(std::string &line, const std::string &file, const std::string &error)
+    {
+        line += "{\"file\":";
+        append_string(line, file);
+        line += ",\"error\":";
+        append_string(line, error);
+        line += "}\n";
+    };
+
+    void write(const std::string &line)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        results << line;
+        if (++pending >= flush_lines) {
+            results.flush();
+            pending = 0;
+        }
+    };
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        results.flush();
+        pending = 0;
+    };
+
+private:
+    // JSON string literal
+    static void append_string(std::string &line, const std::string &s)
+    {
+        line += '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                line += '\\';
+                line += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                line += buf;
+            }
+            else
+                line += c;
+        }
+        line += '"';
+    };
+
+    std::ostream &results;
+    std::mutex lock;
+    size_t pending = 0;
+    size_t flush_lines = 256;
+
+public:
+    explicit BatchResultWriter(std::ostream &Results) : results(Results) {};
+};
+
+// Why a wav cannot go through VAD at sample_rate (0 for 8k or 16k), empty if it
+// can. Multichannel files pass, they are read downmixed.
+inline std::string check_wav(wav::MappedWavReader &reader, const std::string &file, int sample_rate = 0)
+{
+    if (!reader.Open(file))
+        return "cannot read wav";
+    if (sample_rate > 0 ? reader.sample_rate() != sample_rate
+                        : reader.sample_rate() != 8000 && reader.sample_rate() != 16000)
+        return "unsupported sample rate";
+    return std::string();
+}
+
+inline double batch_cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+        + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+// Offline VAD over many files, e.g. a night of short call clips. Files are
+// scheduled on a WorkStealingPool; each worker keeps one iterator per sample
+// rate (built once, over a shared model) and one wav mapping, reused for all
+// its files; multichannel files are downmixed. Results go out through a
+// BatchResultWriter as files complete.
+class FileBatchVad
+{
+public:
+    typedef std::function<std::unique_ptr<VadIterator>(int sample_rate)> iterator_factory_t;
+
+    void process(const std::vector<std::string> &files, std::ostream &results)
+    {
+        std::vector<worker_t> workers(pool.size());
+        BatchResultWriter writer(results);
+
+        double cpu_start = batch_cpu_seconds();
+        auto wall_start = std::chrono::steady_clock::now();
+        pool.run(static_cast<int64_t>(files.size()), [&](int w, int64_t index) {
+            worker_t &worker = workers[w];
+            worker.line.clear();
+            process_file(worker, files[index]);
+            writer.write(worker.line);
+        });
+        writer.flush();
+
+        stats = batch_stats_t();
+        stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        stats.cpu_seconds = batch_cpu_seconds() - cpu_start;
+        for (worker_t &worker : workers)
+            stats.add(worker.stats);
+        std::sort(stats.latencies.begin(), stats.latencies.end());
+    };
+
+    const batch_stats_t &get_stats() const
+    {
+        return stats;
+    };
+
+private:
+    struct worker_t
+    {
+        std::vector<std::pair<int, std::unique_ptr<VadIterator>>> iterators; // by sample rate
+        wav::MappedWavReader reader;
+        std::vector<timestamp_t> speeches;
+        std::string line;
+        batch_stats_t stats;
+    };
+
+    VadIterator &iterator(worker_t &worker, int sample_rate)
+    {
+        for (auto &entry : worker.iterators) {
+            if (entry.first == sample_rate)
+                return *entry.second;
+        }
+        worker.iterators.emplace_back(sample_rate, make_iterator(sample_rate));
+        return *worker.iterators.back().second;
+    };
+
+    void process_file(worker_t &worker, const std::string &file)
+    {
+        auto start = std::chrono::steady_clock::now();
+        worker.stats.files++;
+        std::string error;
+        try {
+            error = check_wav(worker.reader, file);
+            if (error.empty()) {
+                wav::WavChannelReader mono(worker.reader);
+                worker.speeches.clear();
+                iterator(worker, worker.reader.sample_rate()).process(mono, block_samples,
+                    [&](const timestamp_t &speech) { worker.speeches.push_back(speech); });
+            }
+        }
+        catch (const std::exception &e) {
+            error = e.what();
+        }
+
+        if (!error.empty()) {
+            worker.stats.failed++;
+            BatchResultWriter::format_error(worker.line, file, error);
+        }
+        else {
+            double duration = static_cast<double>(worker.reader.num_samples()) / worker.reader.sample_rate();
+            double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            worker.stats.audio_seconds += duration;
+            worker.stats.latencies.push_back(latency);
+            BatchResultWriter::format(worker.line, file, worker.reader.sample_rate(), duration, latency, worker.speeches);
+        }
+        worker.reader.Close();
+    };
+
+    iterator_factory_t make_iterator;
+    WorkStealingPool pool;
+    batch_stats_t stats;
+    int64_t block_samples = 1 << 20; // Release() granularity within a file
+
+public:
+    // Construction. Make_iterator builds the iterator of a worker for a sample
+    // rate (share the model); Threads 0 means one per core.
+    FileBatchVad(iterator_factory_t Make_iterator, int Threads = 0)
+        : make_iterator(Make_iterator), pool(Threads)
+    {
+    };
+};
+
+// Short clips packed into the rows of a BatchedVadEngine, so per-file cost is
+// a row refill rather than an invoke of its own and every invoke stays full.
+// Each row streams one file window by window; when the file ends the row's
+// speeches are written, its state slice in [2, B, 128] and its context are
+// zeroed (reset_stream) and the next file is loaded into it. Segmentation is
+// per row, so results equal running each file on its own iterator.
+// Every thread packs into its own engine and takes the next file from a shared
+// counter; files must be mono at the engine's sample rate.
+class PackedFileVad
+{
+public:
+    typedef std::function<std::unique_ptr<BatchedVadEngine>()> engine_factory_t;
+
+    void process(const std::vector<std::string> &files, std::ostream &results)
+    {
+        BatchResultWriter writer(results);
+        std::atomic<int64_t> next(0);
+        std::vector<batch_stats_t> worker_stats(num_threads);
+
+        double cpu_start = batch_cpu_seconds();
+        auto wall_start = std::chrono::steady_clock::now();
+        auto worker = [&](int w) {
+            std::unique_ptr<BatchedVadEngine> engine = make_engine();
+            pack(*engine, files, next, writer, worker_stats[w]);
+        };
+        std::vector<std::thread> threads;
+        for (int w = 1; w < num_threads; w++)
+            threads.emplace_back(worker, w);
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+        writer.flush();
+
+        stats = batch_stats_t();
+        stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        stats.cpu_seconds = batch_cpu_seconds() - cpu_start;
+        for (const batch_stats_t &worker : worker_stats)
+            stats.add(worker);
+        std::sort(stats.latencies.begin(), stats.latencies.end());
+    };
+
+    const batch_stats_t &get_stats() const
+    {
+        return stats;
+    };
+
+private:
+    struct row_t
+    {
+        int id;
+        int64_t file = -1; // index in files, -1 when the row is idle
+        wav::MappedWavReader reader;
+        int64_t offset = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Loads the next readable file into row, writing an error line for any unreadable one
+    static bool load(row_t &row, BatchedVadEngine &engine, const std::vector<std::string> &files,
+        std::atomic<int64_t> &next, BatchResultWriter &writer, batch_stats_t &stats, std::string &line)
+    {
+        row.file = -1;
+        for (int64_t index = next++; index < static_cast<int64_t>(files.size()); index = next++) {
+            stats.files++;
+            std::string error = check_wav(row.reader, files[index], engine.sample_rate());
+            if (error.empty() && row.reader.num_channel() != 1)
+                error = "not mono"; // rows are read straight from the mapping
+            if (error.empty()) {
+                row.file = index;
+                row.offset = 0;
+                row.start = std::chrono::steady_clock::now();
+                engine.reset_stream(row.id);
+                return true;
+            }
+            stats.failed++;
+            line.clear();
+            BatchResultWriter::format_error(line, files[index], error);
+            writer.write(line);
+        }
+        return false;
+    };
+
+    void pack(BatchedVadEngine &engine, const std::vector<std::string> &files, std::atomic<int64_t> &next,
+        BatchResultWriter &writer, batch_stats_t &stats)
+    {
+        const int64_t window = engine.window_samples();
+        std::vector<row_t> rows(engine.max_batch_size());
+        std::string line;
+        int active = 0;
+        for (row_t &row : rows) {
+            row.id = engine.add_stream();
+            active += load(row, engine, files, next, writer, stats, line);
+        }
+
+        while (active > 0) {
+            for (row_t &row : rows) {
+                if (row.file < 0)
+                    continue;
+                if (row.offset + window <= row.reader.num_samples()) {
+                    // Straight from the mapped clip into its batch row
+                    row.reader.Read(row.offset, window, engine.queue_window(row.id));
+                    row.offset += window;
+                }
+            }
+            engine.run();
+
+            // Rows whose file has no whole window left hand over to the next file
+            for (row_t &row : rows) {
+                if (row.file < 0 || row.offset + window <= row.reader.num_samples())
+                    continue;
+                int64_t length = row.reader.num_samples();
+                engine.finish_stream(row.id, length);
+                double duration = static_cast<double>(length) / row.reader.sample_rate();
+                double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - row.start).count();
+                stats.audio_seconds += duration;
+                stats.latencies.push_back(latency);
+                line.clear();
+                BatchResultWriter::format(line, files[row.file], row.reader.sample_rate(), duration, latency,
+                    engine.get_speech_timestamps(row.id));
+                writer.write(line);
+                row.reader.Close();
+                active -= !load(row, engine, files, next, writer, stats, line);
+            }
+        }
+
+        for (row_t &row : rows)
+            engine.remove_stream(row.id);
+    };
+
+    engine_factory_t make_engine;
+    int num_threads;
+    batch_stats_t stats;
+
+public:
+    // Construction. Make_engine builds the engine of a thread (share the model),
+    // its max batch is the number of rows; Threads 0 means one per core.
+    PackedFileVad(engine_factory_t Make_engine, int Threads = 0)
+        : make_engine(Make_engine),
+          num_threads(Threads > 0 ? Threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency())))
+    {
+    };
+};
+
+#endif  // SILERO_FILE_BATCH_H_
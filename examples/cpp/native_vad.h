@@ -0,0 +1,668 @@
+#ifndef SILERO_NATIVE_VAD_H_
+#define SILERO_NATIVE_VAD_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "vad_iterator.h"
+#include "batched_vad_engine.h"
+
+// Forward pass of silero_vad in plain C++, with weights read straight from the
+// bundled onnx file. No runtime library is needed: the stft front-end, the four
+// conv blocks, the lstm cell and the output head all reduce to matrix-vector
+// products, which run on AVX-512, AVX2 or scalar kernels picked at load time.
+namespace native {
+
+enum isa_t { isa_scalar, isa_avx2, isa_avx512 };
+
+inline isa_t detect_isa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return isa_avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return isa_avx2;
+#endif
+    return isa_scalar;
+}
+
+// y[r] = bias[r] + W[r, :] . x, W is row-major [rows, cols]. bias may be null.
+typedef void (*gemv_fn)(const float *w, const float *bias, const float *x, float *y, int rows, int cols);
+
+inline void gemv_scalar(const float *w, const float *bias, const float *x, float *y, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++) {
+        const float *row = w + static_cast<size_t>(r) * cols;
+        float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        int i = 0;
+        for (; i + 4 <= cols; i += 4) {
+            acc[0] += row[i] * x[i];
+            acc[1] += row[i + 1] * x[i + 1];
+            acc[2] += row[i + 2] * x[i + 2];
+            acc[3] += row[i + 3] * x[i + 3];
+        }
+        for (; i < cols; i++)
+            acc[0] += row[i] * x[i];
+        y[r] = (acc[0] + acc[1]) + (acc[2] + acc[3]) + (bias ? bias[r] : 0.0f);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+inline float hsum_avx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+inline void gemv_avx2(const float *w, const float *bias, const float *x, float *y, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++) {
+        const float *row = w + static_cast<size_t>(r) * cols;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= cols; i += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(row + i), _mm256_loadu_ps(x + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(row + i + 8), _mm256_loadu_ps(x + i + 8), acc1);
+        }
+        for (; i + 8 <= cols; i += 8)
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(row + i), _mm256_loadu_ps(x + i), acc0);
+        float sum = hsum_avx2(_mm256_add_ps(acc0, acc1));
+        for (; i < cols; i++)
+            sum += row[i] * x[i];
+        y[r] = sum + (bias ? bias[r] : 0.0f);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void gemv_avx512(const float *w, const float *bias, const float *x, float *y, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++) {
+        const float *row = w + static_cast<size_t>(r) * cols;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 32 <= cols; i += 32) {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(row + i), _mm512_loadu_ps(x + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(row + i + 16), _mm512_loadu_ps(x + i + 16), acc1);
+        }
+        for (; i + 16 <= cols; i += 16)
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(row + i), _mm512_loadu_ps(x + i), acc0);
+        if (i < cols) {
+            __mmask16 mask = static_cast<__mmask16>((1u << (cols - i)) - 1);
+            acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, row + i), _mm512_maskz_loadu_ps(mask, x + i), acc1);
+        }
+        y[r] = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)) + (bias ? bias[r] : 0.0f);
+    }
+}
+#endif
+
+// isa must not exceed detect_isa()
+inline gemv_fn select_gemv(isa_t isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (isa == isa_avx512)
+        return gemv_avx512;
+    if (isa == isa_avx2)
+        return gemv_avx2;
+#endif
+    return gemv_scalar;
+}
+
+inline float sigmoid(float x)
+{
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+// Just enough protobuf to pull float tensors out of an onnx ModelProto: graph
+// initializers and Constant node values, including those of If subgraphs.
+class onnx_reader
+{
+public:
+    struct tensor_t
+    {
+        std::vector<int64_t> dims;
+        std::vector<float> data;
+    };
+
+    explicit onnx_reader(const std::string &path)
+    {
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (!ifs)
+            throw std::runtime_error("cannot open " + path);
+        buf.resize(static_cast<size_t>(ifs.tellg()));
+        ifs.seekg(0, std::ios::beg);
+        ifs.read(reinterpret_cast<char *>(buf.data()), buf.size());
+
+        // ModelProto.graph = 7
+        const uint8_t *p = buf.data(), *end = p + buf.size();
+        while (p < end) {
+            field_t f = read_field(p, end);
+            if (f.number == 7 && f.wire == 2)
+                read_graph(f.begin, f.end);
+        }
+    }
+
+    const std::map<std::string, tensor_t> &tensors() const
+    {
+        return tensors_;
+    }
+
+private:
+    struct field_t
+    {
+        uint32_t number;
+        uint32_t wire;
+        uint64_t value;       // varint / fixed payload
+        const uint8_t *begin; // length-delimited payload
+        const uint8_t *end;
+    };
+
+    static uint64_t read_varint(const uint8_t *&p, const uint8_t *end)
+    {
+        uint64_t v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        throw std::runtime_error("truncated onnx file");
+    }
+
+    static field_t read_field(const uint8_t *&p, const uint8_t *end)
+    {
+        field_t f = {};
+        uint64_t key = read_varint(p, end);
+        f.number = static_cast<uint32_t>(key >> 3);
+        f.wire = static_cast<uint32_t>(key & 7);
+        switch (f.wire) {
+            case 0:
+                f.value = read_varint(p, end);
+                break;
+            case 1:
+                if (end - p < 8)
+                    throw std::runtime_error("truncated onnx file");
+                std::memcpy(&f.value, p, 8);
+                p += 8;
+                break;
+            case 2: {
+                uint64_t len = read_varint(p, end);
+                if (static_cast<uint64_t>(end - p) < len)
+                    throw std::runtime_error("truncated onnx file");
+                f.begin = p;
+                f.end = p + len;
+                p += len;
+                break;
+            }
+            case 5:
+                if (end - p < 4)
+                    throw std::runtime_error("truncated onnx file");
+                std::memcpy(&f.value, p, 4);
+                p += 4;
+                break;
+            default:
+                throw std::runtime_error("unsupported protobuf wire type");
+        }
+        return f;
+    }
+
+    // GraphProto: node = 1, initializer = 5
+    void read_graph(const uint8_t *p, const uint8_t *end)
+    {
+        while (p < end) {
+            field_t f = read_field(p, end);
+            if (f.wire != 2)
+                continue;
+            if (f.number == 1)
+                read_node(f.begin, f.end);
+            else if (f.number == 5)
+                read_tensor(f.begin, f.end, std::string());
+        }
+    }
+
+    // NodeProto: output = 2, op_type = 4, attribute = 5
+    void read_node(const uint8_t *p, const uint8_t *end)
+    {
+        std::string output, op_type;
+        std::vector<field_t> attributes;
+        while (p < end) {
+            field_t f = read_field(p, end);
+            if (f.wire != 2)
+                continue;
+            if (f.number == 2 && output.empty())
+                output.assign(reinterpret_cast<const char *>(f.begin), f.end - f.begin);
+            else if (f.number == 4)
+                op_type.assign(reinterpret_cast<const char *>(f.begin), f.end - f.begin);
+            else if (f.number == 5)
+                attributes.push_back(f);
+        }
+
+        // AttributeProto: t = 5, g = 6, graphs = 11
+        for (const field_t &attribute : attributes) {
+            const uint8_t *q = attribute.begin;
+            while (q < attribute.end) {
+                field_t f = read_field(q, attribute.end);
+                if (f.wire != 2)
+                    continue;
+                if (f.number == 5 && op_type == "Constant")
+                    read_tensor(f.begin, f.end, output);
+                else if (f.number == 6 || f.number == 11)
+                    read_graph(f.begin, f.end);
+            }
+        }
+    }
+
+    // TensorProto: dims = 1, data_type = 2, float_data = 4, name = 8, raw_data = 9
+    void read_tensor(const uint8_t *p, const uint8_t *end, std::string name)
+    {
+        tensor_t tensor;
+        uint64_t data_type = 0;
+        const uint8_t *raw = nullptr, *raw_end = nullptr;
+        std::vector<float> float_data;
+        while (p < end) {
+            field_t f = read_field(p, end);
+            if (f.number == 1 && f.wire == 0) {
+                tensor.dims.push_back(static_cast<int64_t>(f.value));
+            }
+            else if (f.number == 1 && f.wire == 2) {
+                for (const uint8_t *q = f.begin; q < f.end;)
+                    tensor.dims.push_back(static_cast<int64_t>(read_varint(q, f.end)));
+            }
+            else if (f.number == 2 && f.wire == 0) {
+                data_type = f.value;
+            }
+            else if (f.number == 4 && f.wire == 5) {
+                float v;
+                std::memcpy(&v, &f.value, 4);
+                float_data.push_back(v);
+            }
+            else if (f.number == 4 && f.wire == 2) {
+                size_t n = (f.end - f.begin) / 4;
+                size_t offset = float_data.size();
+                float_data.resize(offset + n);
+                std::memcpy(&float_data[offset], f.begin, n * 4);
+            }
+            else if (f.number == 8 && f.wire == 2 && name.empty()) {
+                name.assign(reinterpret_cast<const char *>(f.begin), f.end - f.begin);
+            }
+            else if (f.number == 9 && f.wire == 2) {
+                raw = f.begin;
+                raw_end = f.end;
+            }
+        }
+
+        // TensorProto.FLOAT, everything else (shapes, indices) is of no use here
+        if (data_type != 1 || name.empty())
+            return;
+        if (raw) {
+            tensor.data.resize((raw_end - raw) / 4);
+            std::memcpy(tensor.data.data(), raw, tensor.data.size() * 4);
+        }
+        else {
+            tensor.data.swap(float_data);
+        }
+        tensors_[name] = std::move(tensor);
+    }
+
+    std::vector<uint8_t> buf;
+    std::map<std::string, tensor_t> tensors_;
+};
+
+// Per call temporaries of one forward pass, sized once so inference never allocates
+struct scratch_t
+{
+    std::vector<float> padded;  // reflect padded window
+    std::vector<float> spectrum; // [2 * bins] of one frame
+    std::vector<float> features[2]; // ping-pong [channels, frames]
+    std::vector<float> columns; // im2col of one output frame
+    std::vector<float> gates;   // [4 * 128]
+    std::vector<float> recurrent; // [4 * 128]
+    std::vector<float> hidden;  // relu(h)
+};
+
+} // namespace native
+
+// The weights of every sample rate found in the onnx file, shared read-only by
+// any number of iterators and engines.
+class NativeVadModel
+{
+public:
+    static constexpr int hidden_size = 128;
+
+    struct conv_t
+    {
+        std::vector<float> weight; // [out, in * 3]
+        std::vector<float> bias;
+        int out_channels;
+        int in_channels;
+        int stride;
+    };
+
+    struct weights_t
+    {
+        int filter_length;
+        int hop_length;
+        int pad;
+        int bins;
+        std::vector<float> basis; // [2 * bins, filter_length]
+        conv_t encoder[4];
+        std::vector<float> weight_ih; // [4 * 128, 128], gates i f g o
+        std::vector<float> weight_hh;
+        std::vector<float> bias;      // bias_ih + bias_hh
+        std::vector<float> decoder_weight;
+        float decoder_bias;
+    };
+
+    // Weights for 8000 or 16000, throws if the file has no branch for the rate
+    const weights_t &weights(int sample_rate) const
+    {
+        auto it = rates.find(sample_rate);
+        if (it == rates.end())
+            throw std::invalid_argument("model has no weights for sample rate " + std::to_string(sample_rate));
+        return it->second;
+    };
+
+    native::isa_t isa() const
+    {
+        return isa_;
+    };
+
+    // Frames of the stft for a window of length samples
+    static int frames(const weights_t &w, int length)
+    {
+        return (length + w.pad - w.filter_length) / w.hop_length + 1;
+    };
+
+    // Size the temporaries of forward() for windows of length samples
+    void init_scratch(native::scratch_t &scratch, int sample_rate, int length) const
+    {
+        const weights_t &w = weights(sample_rate);
+        int t = frames(w, length);
+        if (length < w.filter_length || encoder_frames(t) != 1)
+            throw std::invalid_argument("window of " + std::to_string(length) + " samples is not supported by the model");
+        size_t feature_size = std::max<size_t>(w.bins, hidden_size) * t;
+        scratch.padded.assign(length + w.pad, 0.0f);
+        scratch.spectrum.assign(2 * w.bins, 0.0f);
+        scratch.features[0].assign(feature_size, 0.0f);
+        scratch.features[1].assign(feature_size, 0.0f);
+        scratch.columns.assign(3 * std::max(w.bins, hidden_size), 0.0f);
+        scratch.gates.assign(4 * hidden_size, 0.0f);
+        scratch.recurrent.assign(4 * hidden_size, 0.0f);
+        scratch.hidden.assign(hidden_size, 0.0f);
+    };
+
+    // One window: x[length] and the previous state (h, c) -> speech probability
+    // and the next state (h_out, c_out). h/c may alias h_out/c_out.
+    float forward(const float *x, int length, int sample_rate,
+        const float *h, const float *c, float *h_out, float *c_out, native::scratch_t &scratch) const
+    {
+        const weights_t &w = weights(sample_rate);
+
+        // stft: reflect pad on the right, strided conv with the basis, magnitude
+        float *padded = scratch.padded.data();
+        std::memcpy(padded, x, length * sizeof(float));
+        for (int i = 0; i < w.pad; i++)
+            padded[length + i] = x[length - 2 - i];
+
+        int t_in = frames(w, length);
+        float *features = scratch.features[0].data();
+        for (int t = 0; t < t_in; t++) {
+            gemv(w.basis.data(), nullptr, padded + t * w.hop_length, scratch.spectrum.data(), 2 * w.bins, w.filter_length);
+            for (int f = 0; f < w.bins; f++) {
+                float re = scratch.spectrum[f];
+                float im = scratch.spectrum[w.bins + f];
+                features[f * t_in + t] = std::sqrt(re * re + im * im);
+            }
+        }
+
+        // encoder: conv k=3 pad=1 + relu, features are [channels, frames]
+        int cur = 0;
+        for (const conv_t &conv : w.encoder) {
+            const float *in = scratch.features[cur].data();
+            float *out = scratch.features[cur ^ 1].data();
+            int t_out = (t_in - 1) / conv.stride + 1;
+            float *columns = scratch.columns.data();
+            float *column_out = scratch.gates.data(); // reused, out_channels <= 4 * 128
+            for (int t = 0; t < t_out; t++) {
+                for (int i = 0; i < conv.in_channels; i++) {
+                    for (int k = 0; k < 3; k++) {
+                        int src = t * conv.stride + k - 1;
+                        columns[i * 3 + k] = (src >= 0 && src < t_in) ? in[i * t_in + src] : 0.0f;
+                    }
+                }
+                gemv(conv.weight.data(), conv.bias.data(), columns, column_out, conv.out_channels, conv.in_channels * 3);
+                for (int o = 0; o < conv.out_channels; o++)
+                    out[o * t_out + t] = column_out[o] > 0.0f ? column_out[o] : 0.0f;
+            }
+            t_in = t_out;
+            cur ^= 1;
+        }
+        const float *encoded = scratch.features[cur].data(); // [128, 1]
+
+        // decoder: lstm cell, gates in pytorch order i f g o
+        float *gates = scratch.gates.data();
+        float *hidden = scratch.hidden.data();
+        float *recurrent = scratch.recurrent.data();
+        gemv(w.weight_ih.data(), w.bias.data(), encoded, gates, 4 * hidden_size, hidden_size);
+        gemv(w.weight_hh.data(), nullptr, h, recurrent, 4 * hidden_size, hidden_size);
+        for (int r = 0; r < 4 * hidden_size; r++)
+            gates[r] += recurrent[r];
+        for (int j = 0; j < hidden_size; j++) {
+            float in_gate = native::sigmoid(gates[j]);
+            float forget_gate = native::sigmoid(gates[hidden_size + j]);
+            float cell_gate = std::tanh(gates[2 * hidden_size + j]);
+            float out_gate = native::sigmoid(gates[3 * hidden_size + j]);
+            float c_new = forget_gate * c[j] + in_gate * cell_gate;
+            hidden[j] = out_gate * std::tanh(c_new);
+            c_out[j] = c_new;
+        }
+        std::memcpy(h_out, hidden, hidden_size * sizeof(float));
+
+        // relu, 1x1 conv to one channel, sigmoid
+        for (int j = 0; j < hidden_size; j++)
+            hidden[j] = hidden[j] > 0.0f ? hidden[j] : 0.0f;
+        float logit;
+        gemv(w.decoder_weight.data(), nullptr, hidden, &logit, 1, hidden_size);
+        return native::sigmoid(logit + w.decoder_bias);
+    };
+
+private:
+    std::map<int, weights_t> rates;
+    native::isa_t isa_;
+    native::gemv_fn gemv_kernel;
+
+    void gemv(const float *w, const float *bias, const float *x, float *y, int rows, int cols) const
+    {
+        gemv_kernel(w, bias, x, y, rows, cols);
+    };
+
+    static int encoder_frames(int t)
+    {
+        t = (t - 1) / 2 + 1;
+        return (t - 1) / 2 + 1;
+    };
+
+    static const native::onnx_reader::tensor_t &find(const std::map<std::string, native::onnx_reader::tensor_t> &tensors,
+        const std::string &prefix, const std::string &name, size_t size)
+    {
+        auto it = tensors.find(prefix + name);
+        if (it == tensors.end() || it->second.data.size() != size)
+            throw std::runtime_error("onnx model has no usable " + name);
+        return it->second;
+    };
+
+    void load(const std::string &model_path)
+    {
+        native::onnx_reader reader(model_path);
+        const auto &tensors = reader.tensors();
+
+        // One weight set per stft basis, the filter length tells the sample rate
+        const std::string basis_name = "stft.forward_basis_buffer";
+        for (const auto &entry : tensors) {
+            const std::string &name = entry.first;
+            if (name.size() < basis_name.size() || name.compare(name.size() - basis_name.size(), basis_name.size(), basis_name) != 0)
+                continue;
+            const auto &dims = entry.second.dims;
+            if (dims.size() != 3)
+                continue;
+            std::string prefix = name.substr(0, name.size() - basis_name.size());
+
+            weights_t w;
+            w.filter_length = static_cast<int>(dims[2]);
+            w.hop_length = w.filter_length / 2;
+            w.pad = w.filter_length / 4;
+            w.bins = w.filter_length / 2 + 1;
+            int sample_rate = w.filter_length == 256 ? 16000 : w.filter_length == 128 ? 8000 : 0;
+            if (sample_rate == 0 || dims[0] != 2 * w.bins)
+                continue;
+            w.basis = entry.second.data;
+
+            const int channels[5] = { w.bins, 128, 64, 64, 128 };
+            const int strides[4] = { 1, 2, 2, 1 };
+            for (int i = 0; i < 4; i++) {
+                conv_t &conv = w.encoder[i];
+                std::string layer = "encoder." + std::to_string(i) + ".reparam_conv.";
+                conv.in_channels = channels[i];
+                conv.out_channels = channels[i + 1];
+                conv.stride = strides[i];
+                conv.weight = find(tensors, prefix, layer + "weight", conv.out_channels * conv.in_channels * 3).data;
+                conv.bias = find(tensors, prefix, layer + "bias", conv.out_channels).data;
+            }
+
+            w.weight_ih = find(tensors, prefix, "decoder.rnn.weight_ih", 4 * hidden_size * hidden_size).data;
+            w.weight_hh = find(tensors, prefix, "decoder.rnn.weight_hh", 4 * hidden_size * hidden_size).data;
+            w.bias = find(tensors, prefix, "decoder.rnn.bias_ih", 4 * hidden_size).data;
+            const auto &bias_hh = find(tensors, prefix, "decoder.rnn.bias_hh", 4 * hidden_size).data;
+            for (int i = 0; i < 4 * hidden_size; i++)
+                w.bias[i] += bias_hh[i];
+            w.decoder_weight = find(tensors, prefix, "decoder.decoder.2.weight", hidden_size).data;
+            w.decoder_bias = find(tensors, prefix, "decoder.decoder.2.bias", 1).data[0];
+            rates[sample_rate] = std::move(w);
+        }
+
+        if (rates.empty())
+            throw std::runtime_error(model_path + " is not a silero_vad onnx model");
+    };
+
+public:
+    // Construction
+    NativeVadModel(const std::string& model_path, native::isa_t isa = native::detect_isa())
+    {
+        load(model_path);
+        isa_ = std::min(isa, native::detect_isa());
+        gemv_kernel = native::select_gemv(isa_);
+    }
+};
+
+class NativeVadIterator: public VadIterator
+{
+private:
+    std::shared_ptr<NativeVadModel> model;
+    native::scratch_t scratch;
+
+    void init_model()
+    {
+        model->init_scratch(scratch, sample_rate, static_cast<int>(context_samples + window_size_samples));
+    };
+
+    void predict()
+    {
+        // Infer [context | window] in place, the state is updated in place too
+        const int hidden = NativeVadModel::hidden_size;
+        float speech_prob;
+        {
+            VAD_STAGE(stage_timers, stage_infer);
+            speech_prob = model->forward(input.data(), static_cast<int>(context_samples + window_size_samples), sample_rate,
+                _state.data(), _state.data() + hidden, _state.data(), _state.data() + hidden, scratch);
+        }
+
+        segment(speech_prob);
+    };
+
+public:
+    // Construction
+    NativeVadIterator(const std::string ModelPath,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): NativeVadIterator(
+        std::make_shared<NativeVadModel>(ModelPath), Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+    }
+
+    NativeVadIterator(std::shared_ptr<NativeVadModel> Model,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s),
+        model(Model)
+    {
+        init_model();
+    }
+};
+
+// Rows are independent in the native engine, a batch is a loop over them
+class NativeBatchedVadEngine: public BatchedVadEngine
+{
+private:
+    std::shared_ptr<NativeVadModel> model;
+    native::scratch_t scratch;
+
+    void infer(int rows)
+    {
+        const int hidden = NativeVadModel::hidden_size;
+        const int64_t row_samples = context_samples + window_size_samples;
+        VAD_STAGE(stage_timers, stage_infer);
+        for (int r = 0; r < rows; r++) {
+            output[r] = model->forward(&input[r * row_samples], static_cast<int>(row_samples), static_cast<int>(sr[0]),
+                &_state[r * hidden], &_state[(rows + r) * hidden],
+                &_stateN[r * hidden], &_stateN[(rows + r) * hidden], scratch);
+        }
+    };
+
+public:
+    // Construction
+    NativeBatchedVadEngine(std::shared_ptr<NativeVadModel> Model, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): BatchedVadEngine(Max_batch, Sample_rate,
+        windows_frame_size, Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s),
+        model(Model)
+    {
+        model->init_scratch(scratch, Sample_rate, static_cast<int>(context_samples + window_size_samples));
+    }
+
+    NativeBatchedVadEngine(const std::string ModelPath, int Max_batch,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): NativeBatchedVadEngine(
+        std::make_shared<NativeVadModel>(ModelPath), Max_batch, Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+    }
+};
+
+#endif  // SILERO_NATIVE_VAD_H_
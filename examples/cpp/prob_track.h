@@ -0,0 +1,93 @@
+#ifndef SILERO_PROB_TRACK_H_
+#define SILERO_PROB_TRACK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Speech probability of every window. This is all segmentation needs, so a
+// track recorded once can be re-segmented with any threshold / silence /
+// padding setting without running the model again. Probabilities stay float in
+// memory, so segmenting a recorded or stitched track gives what the live run
+// gave; save() quantises them to one byte (p * 255), which only matters for
+// probabilities within 1/510 of a threshold.
+class ProbTrack
+{
+public:
+    int sample_rate = 0;
+    int64_t window_size_samples = 0;
+    int64_t audio_length_samples = 0;
+    std::vector<float> probs;
+
+    void clear()
+    {
+        probs.clear();
+        audio_length_samples = 0;
+    };
+
+    void push(float prob)
+    {
+        probs.push_back(prob);
+    };
+
+    float prob(size_t index) const
+    {
+        return probs[index];
+    };
+
+    size_t size() const
+    {
+        return probs.size();
+    };
+
+    // File layout: "SVPT", version, sample_rate, window, audio length, count, probs
+    void save(const std::string &path) const
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+            throw std::runtime_error("cannot write " + path);
+        uint32_t header[2] = { magic, version };
+        int64_t fields[4] = { sample_rate, window_size_samples, audio_length_samples, static_cast<int64_t>(probs.size()) };
+        ofs.write(reinterpret_cast<const char *>(header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(fields), sizeof(fields));
+        std::vector<uint8_t> quantised(probs.size());
+        for (size_t i = 0; i < probs.size(); i++)
+            quantised[i] = static_cast<uint8_t>(std::min(std::max(probs[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        ofs.write(reinterpret_cast<const char *>(quantised.data()), quantised.size());
+        if (!ofs)
+            throw std::runtime_error("cannot write " + path);
+    };
+
+    void load(const std::string &path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs)
+            throw std::runtime_error("cannot open " + path);
+        uint32_t header[2] = {};
+        int64_t fields[4] = {};
+        ifs.read(reinterpret_cast<char *>(header), sizeof(header));
+        ifs.read(reinterpret_cast<char *>(fields), sizeof(fields));
+        if (!ifs || header[0] != magic || header[1] != version || fields[3] < 0)
+            throw std::runtime_error(path + " is not a probability track");
+        sample_rate = static_cast<int>(fields[0]);
+        window_size_samples = fields[1];
+        audio_length_samples = fields[2];
+        std::vector<uint8_t> quantised(static_cast<size_t>(fields[3]));
+        ifs.read(reinterpret_cast<char *>(quantised.data()), quantised.size());
+        if (!ifs)
+            throw std::runtime_error(path + " is truncated");
+        probs.resize(quantised.size());
+        for (size_t i = 0; i < quantised.size(); i++)
+            probs[i] = quantised[i] * (1.0f / 255);
+    };
+
+private:
+    static const uint32_t magic = 0x54505653; // "SVPT"
+    static const uint32_t version = 1;
+};
+
+#endif  // SILERO_PROB_TRACK_H_
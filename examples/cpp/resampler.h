@@ -0,0 +1,402 @@
+#ifndef SILERO_RESAMPLER_H_
+#define SILERO_RESAMPLER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace resample {
+
+// Polyphase filter loop: writes the outputs whose newest input sample is
+// below end. An output at (position, phase) is the dot of the taps samples up
+// to samples[position] with phase's coefficients; the next one is whole input
+// samples and frac phases (of up) later.
+struct filter_step_t
+{
+    size_t taps;
+    size_t up;
+    size_t whole;
+    size_t frac;
+};
+
+inline void advance(const filter_step_t &step, size_t &position, size_t &phase)
+{
+    position += step.whole;
+    phase += step.frac;
+    if (phase >= step.up) {
+        phase -= step.up;
+        position++;
+    }
+}
+
+inline size_t filter_scalar(const float *samples, size_t end, const float *coefficients, const filter_step_t &step,
+    size_t &position, size_t &phase, float *out)
+{
+    size_t produced = 0;
+    while (position < end) {
+        const float *x = samples + position + 1 - step.taps;
+        const float *c = coefficients + phase * step.taps;
+        float acc[8] = {};
+        for (size_t i = 0; i < step.taps; i += 8) {
+            for (int k = 0; k < 8; k++)
+                acc[k] += x[i + k] * c[i + k];
+        }
+        out[produced++] = ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+        advance(step, position, phase);
+    }
+    return produced;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Four outputs at a time, so the fma chains overlap and one horizontal
+// reduction serves all four; taps is a multiple of 8 and the coefficients
+// are 32 byte aligned
+__attribute__((target("avx2,fma")))
+inline size_t filter_avx2(const float *samples, size_t end, const float *coefficients, const filter_step_t &step,
+    size_t &position, size_t &phase, float *out)
+{
+    size_t produced = 0;
+    for (;;) {
+        size_t p[4] = {position}, f[4] = {phase};
+        for (int j = 1; j < 4; j++) {
+            p[j] = p[j - 1];
+            f[j] = f[j - 1];
+            advance(step, p[j], f[j]);
+        }
+        if (p[3] >= end)
+            break;
+        __m256 acc[4];
+        for (int j = 0; j < 4; j++)
+            acc[j] = _mm256_setzero_ps();
+        if (step.up == 1) {
+            // Integer decimation: one phase, its coefficients loaded once for all four
+            for (size_t i = 0; i < step.taps; i += 8) {
+                __m256 c = _mm256_load_ps(coefficients + i);
+                for (int j = 0; j < 4; j++)
+                    acc[j] = _mm256_fmadd_ps(_mm256_loadu_ps(samples + p[j] + 1 - step.taps + i), c, acc[j]);
+            }
+        }
+        else {
+            for (size_t i = 0; i < step.taps; i += 8) {
+                for (int j = 0; j < 4; j++)
+                    acc[j] = _mm256_fmadd_ps(_mm256_loadu_ps(samples + p[j] + 1 - step.taps + i),
+                        _mm256_load_ps(coefficients + f[j] * step.taps + i), acc[j]);
+            }
+        }
+        __m256 sums = _mm256_hadd_ps(_mm256_hadd_ps(acc[0], acc[1]), _mm256_hadd_ps(acc[2], acc[3]));
+        _mm_storeu_ps(out + produced, _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1)));
+        produced += 4;
+        position = p[3];
+        phase = f[3];
+        advance(step, position, phase);
+    }
+    return produced + filter_scalar(samples, end, coefficients, step, position, phase, out + produced);
+}
+#endif
+
+typedef size_t (*filter_fn)(const float *samples, size_t end, const float *coefficients, const filter_step_t &step,
+    size_t &position, size_t &phase, float *out);
+
+// Kernel for this cpu, picked once
+inline filter_fn select_filter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return filter_avx2;
+#endif
+    return filter_scalar;
+}
+
+inline size_t filter(const float *samples, size_t end, const float *coefficients, const filter_step_t &step,
+    size_t &position, size_t &phase, float *out)
+{
+    static const filter_fn kernel = select_filter();
+    return kernel(samples, end, coefficients, step, position, phase, out);
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+inline double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+} // namespace resample
+
+// Streaming polyphase resampler from any rate to any rate (e.g. 48000 or
+// 44100 to the 16000 of the model). The rates are reduced to L/M; the
+// prototype is a Kaiser windowed sinc cut at the lower Nyquist frequency,
+// passing 80% of it and 60 dB down where aliases would fold back below that,
+// split into L phases of taps() coefficients. Each output sample is one
+// vectorised dot product (four at a time with AVX2), so 48 kHz to 16 kHz
+// costs 56 multiply-adds per output sample. The filter delay is compensated: output sample n is centered
+// on input time n * M / L, and the input history is kept across chunks.
+class PolyphaseResampler
+{
+public:
+    // Appends count input samples and writes the output samples they complete
+    // to out, which holds at least max_output(count); returns how many
+    size_t process(const float *in, size_t count, float *out)
+    {
+        return run(in, count, out, [](const float *src, float *dst, size_t n) {
+            std::memcpy(dst, src, n * sizeof(float));
+        });
+    };
+
+    size_t process(const int16_t *in, size_t count, float *out)
+    {
+        return run(in, count, out, [](const int16_t *src, float *dst, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                dst[i] = src[i] * (1.0f / 32768);
+        });
+    };
+
+    // Output samples the input still owes because of the filter delay, as if
+    // the input ended in silence; out holds at least max_output(taps())
+    size_t flush(float *out)
+    {
+        return process(silence.data(), silence.size(), out);
+    };
+
+    // Bound on the output of count more input samples
+    size_t max_output(size_t count) const
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(buffer.size() + count) * up) / down) + 2;
+    };
+
+    // Forget the input, as for a new stream
+    void reset()
+    {
+        buffer.assign(taps_ - 1, 0.0f);
+        position = taps_ - 1 + delay / up;
+        phase = delay % up;
+    };
+
+    int input_rate() const { return in_rate; };
+    int output_rate() const { return out_rate; };
+    int taps() const { return static_cast<int>(taps_); };
+
+private:
+    template <typename T, typename Convert>
+    size_t run(const T *in, size_t count, float *out, Convert convert)
+    {
+        size_t produced = 0;
+        while (count > 0) {
+            // Bounded chunks, so the buffer does not grow with the caller's block
+            size_t take = std::min(count, block);
+            size_t size = buffer.size();
+            buffer.resize(size + take);
+            convert(in, buffer.data() + size, take);
+            in += take;
+            count -= take;
+
+            produced += resample::filter(buffer.data(), buffer.size(), coefficients.data(), step, position, phase,
+                out + produced);
+            // Keep the taps_ - 1 samples before the next output's newest one
+            size_t drop = std::min(position - (taps_ - 1), buffer.size());
+            buffer.erase(buffer.begin(), buffer.begin() + drop);
+            position -= drop;
+        }
+        return produced;
+    };
+
+    template <typename T>
+    struct aligned_allocator
+    {
+        typedef T value_type;
+        aligned_allocator() = default;
+        template <typename U> aligned_allocator(const aligned_allocator<U> &) {}
+        T *allocate(size_t n)
+        {
+            void *p = nullptr;
+            if (posix_memalign(&p, 32, n * sizeof(T)) != 0)
+                throw std::bad_alloc();
+            return static_cast<T *>(p);
+        };
+        void deallocate(T *p, size_t) { free(p); };
+        bool operator==(const aligned_allocator &) const { return true; };
+        bool operator!=(const aligned_allocator &) const { return false; };
+    };
+
+    void init_filter()
+    {
+        const double pi = 3.14159265358979323846;
+        const double nyquist = std::min(in_rate, out_rate) / 2.0;
+        const double attenuation = 60.0;
+        const double beta = 0.1102 * (attenuation - 8.7);
+        // Pass band to 0.8 Nyquist; the stop band starts where aliases or
+        // images would fold back into it, at 1.2 Nyquist
+        const double transition = 0.4 * nyquist;
+        size_t per_phase = static_cast<size_t>(std::ceil((attenuation - 8) * in_rate / (2.285 * 2 * pi * transition)));
+        taps_ = std::max<size_t>(8, (per_phase + 7) / 8 * 8);
+
+        // Prototype at in_rate * up, cut at Nyquist, DC gain up; one tap short
+        // of taps_ * up (even), so its center falls on a sample
+        const size_t length = taps_ * up - 1;
+        const double center = (length - 1) / 2.0;
+        const double cutoff = nyquist / (static_cast<double>(in_rate) * up);
+        std::vector<double> prototype(taps_ * up, 0.0);
+        double sum = 0;
+        for (size_t n = 0; n < length; n++) {
+            double t = n - center;
+            double sinc = t == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * t) / (pi * t);
+            double r = 2 * t / (length - 1);
+            prototype[n] = sinc * resample::bessel_i0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / resample::bessel_i0(beta);
+            sum += prototype[n];
+        }
+        // Phase p reversed, so its dot runs forward over the oldest to newest input
+        coefficients.assign(up * taps_, 0.0f);
+        for (size_t p = 0; p < up; p++) {
+            for (size_t k = 0; k < taps_; k++)
+                coefficients[p * taps_ + (taps_ - 1 - k)] = static_cast<float>(prototype[p + k * up] * up / sum);
+        }
+        delay = (length - 1) / 2;
+        step = {taps_, up, down / up, down % up};
+    };
+
+    int in_rate;
+    int out_rate;
+    size_t up;   // L
+    size_t down; // M
+    size_t taps_ = 0;
+    size_t delay = 0; // of the prototype, in samples at in_rate * up
+    resample::filter_step_t step;
+    std::vector<float, aligned_allocator<float>> coefficients;
+    std::vector<float> buffer;   // input from taps_ - 1 samples before the next output's newest one
+    std::vector<float> silence;  // taps_ zeros, what flush() feeds
+    size_t position = 0;         // buffer index of the next output's newest input sample
+    size_t phase = 0;
+    static constexpr size_t block = 4096;
+
+public:
+    // Construction
+    PolyphaseResampler(int Input_rate, int Output_rate)
+        : in_rate(Input_rate), out_rate(Output_rate)
+    {
+        if (in_rate <= 0 || out_rate <= 0)
+            throw std::invalid_argument("sample rates must be positive, got " + std::to_string(in_rate) + " and " + std::to_string(out_rate));
+        int g = std::gcd(in_rate, out_rate);
+        up = static_cast<size_t>(out_rate / g);
+        down = static_cast<size_t>(in_rate / g);
+        init_filter();
+        silence.assign(taps_, 0.0f);
+        buffer.reserve(taps_ + block);
+        reset();
+    };
+};
+
+// Reader (e.g. wav::MappedWavReader) seen at another sample rate, for the
+// process() overloads of VadIterator. The filter and read position live in
+// the reader, so it is for one thread reading in order, as process() does: a
+// read elsewhere restarts the filter at that point. is_sequential_reader
+// marks it so the sharded paths refuse it at compile time.
+template <typename Reader>
+class ResampledReader
+{
+public:
+    int sample_rate() const { return resampler.output_rate(); };
+    int64_t num_samples() const { return num_samples_; };
+
+    int64_t Read(int64_t offset, int64_t count, float *dst) const
+    {
+        count = std::max<int64_t>(0, std::min(count, num_samples_ - offset));
+        if (offset != next_offset)
+            seek(offset);
+        int64_t done = 0;
+        while (done < count) {
+            if (staged_used == staged_size) {
+                fill();
+                continue;
+            }
+            int64_t take = std::min<int64_t>(count - done, staged_size - staged_used);
+            std::memcpy(dst + done, staged.data() + staged_used, take * sizeof(float));
+            staged_used += take;
+            done += take;
+        }
+        next_offset = offset + count;
+        return count;
+    };
+
+    // Releases the source samples behind output offset + count
+    void Release(int64_t offset, int64_t count) const
+    {
+        int64_t begin = to_source(offset);
+        source.Release(begin, to_source(offset + count) - begin);
+    };
+
+private:
+    int64_t to_source(int64_t offset) const
+    {
+        return static_cast<int64_t>(static_cast<double>(offset) * source.sample_rate() / sample_rate());
+    };
+
+    void seek(int64_t offset) const
+    {
+        resampler.reset();
+        staged_used = staged_size = 0;
+        source_offset = to_source(offset);
+        next_offset = offset;
+    };
+
+    // Resamples the next block of the source, then silence past its end
+    void fill() const
+    {
+        int64_t count = std::min<int64_t>(block, source.num_samples() - source_offset);
+        if (count > 0) {
+            source.Read(source_offset, count, input.data());
+            source_offset += count;
+            staged_size = resampler.process(input.data(), count, staged.data());
+        }
+        else
+            staged_size = resampler.flush(staged.data());
+        staged_used = 0;
+    };
+
+    static constexpr int64_t block = 4096;
+    const Reader &source;
+    mutable PolyphaseResampler resampler;
+    int64_t num_samples_;
+    mutable std::vector<float> input;
+    mutable std::vector<float> staged;
+    mutable int64_t staged_used = 0;
+    mutable int64_t staged_size = 0;
+    mutable int64_t source_offset = 0;
+    mutable int64_t next_offset = 0;
+
+public:
+    // Construction
+    ResampledReader(const Reader &Source, int Sample_rate)
+        : source(Source), resampler(Source.sample_rate(), Sample_rate),
+          num_samples_(static_cast<int64_t>(static_cast<double>(Source.num_samples()) * Sample_rate / Source.sample_rate())),
+          input(block)
+    {
+        staged.resize(std::max(resampler.max_output(block), resampler.max_output(resampler.taps())));
+    };
+};
+
+// Readers that keep a read position and must be read in order by a single
+// thread, which ShardedVad and TimeBatchedVad do not do
+template <typename Reader>
+struct is_sequential_reader : std::false_type {};
+
+template <typename Reader>
+struct is_sequential_reader<ResampledReader<Reader>> : std::true_type {};
+
+#endif  // SILERO_RESAMPLER_H_
@@ -0,0 +1,297 @@
+#ifndef SILERO_SHARDED_VAD_H_
+#define SILERO_SHARDED_VAD_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "vad_iterator.h"
+#include "batched_vad_engine.h"
+
+// How far two shards disagree over the windows they both inferred: the end
+// of shard k - 1 and the warm-up of shard k, which started from a zero state.
+struct shard_report_t
+{
+    int64_t boundary_sample;  // first sample owned by the later shard
+    int64_t overlap_windows;
+    float max_divergence;     // max |p(k - 1) - p(k)| over the overlap
+    float mean_divergence;
+    float boundary_divergence; // on the last overlap window, right before the boundary
+    int64_t converged_after;  // warm-up windows until the divergence stays <= 2/255
+};
+
+// Whole windows of a file split into shards: shard k owns windows
+// [first[k], first[k + 1]) and is inferred from start[k], warm-up included.
+struct shard_plan_t
+{
+    int64_t window;
+    int64_t audio_length;
+    std::vector<int64_t> first;
+    std::vector<int64_t> start;
+
+    shard_plan_t(int64_t Audio_length, int64_t Window, int Shards, int64_t Warmup_samples)
+        : window(Window), audio_length(Audio_length)
+    {
+        const int64_t total_windows = audio_length / window;
+        const int shards = static_cast<int>(std::max<int64_t>(1, std::min<int64_t>(Shards, total_windows)));
+        const int64_t warmup = std::max<int64_t>(0, Warmup_samples / window);
+        first.resize(shards + 1);
+        start.resize(shards);
+        for (int k = 0; k <= shards; k++)
+            first[k] = total_windows * k / shards;
+        for (int k = 0; k < shards; k++)
+            start[k] = std::max<int64_t>(0, first[k] - warmup);
+    };
+
+    int shards() const
+    {
+        return static_cast<int>(start.size());
+    };
+
+    // Windows shard k infers, warm-up included
+    int64_t length(int k) const
+    {
+        return first[k + 1] - start[k];
+    };
+
+    // Concatenate the owned windows of every shard track into one track of the
+    // file, and report the disagreement over each overlap.
+    void stitch(const std::vector<ProbTrack> &tracks, ProbTrack &track, std::vector<shard_report_t> &reports) const
+    {
+        track.sample_rate = tracks[0].sample_rate;
+        track.window_size_samples = window;
+        track.audio_length_samples = audio_length;
+        track.probs.clear();
+        track.probs.reserve(first.back());
+        reports.clear();
+        for (int k = 0; k < shards(); k++) {
+            int64_t overlap = first[k] - start[k];
+            if (k > 0)
+                reports.push_back(compare(tracks[k - 1], tracks[k], overlap, first[k] * window));
+            track.probs.insert(track.probs.end(), tracks[k].probs.begin() + overlap, tracks[k].probs.end());
+        }
+    };
+
+    static shard_report_t compare(const ProbTrack &previous, const ProbTrack &current, int64_t overlap, int64_t boundary)
+    {
+        shard_report_t report = { boundary, overlap, 0.0f, 0.0f, 0.0f, 0 };
+        size_t offset = previous.size() - overlap; // the overlap is the tail of the previous shard
+        double sum = 0.0;
+        for (int64_t i = 0; i < overlap; i++) {
+            float divergence = std::fabs(previous.prob(offset + i) - current.prob(i));
+            report.max_divergence = std::max(report.max_divergence, divergence);
+            sum += divergence;
+            if (divergence > 2.0f / 255)
+                report.converged_after = i + 1;
+            report.boundary_divergence = divergence;
+        }
+        report.mean_divergence = overlap > 0 ? static_cast<float>(sum / overlap) : 0.0f;
+        return report;
+    };
+};
+
+// Offline mode for one long file: the file is cut into shards of whole windows,
+// every shard runs on its own iterator and thread from a zero state, starting
+// warm-up windows early so the lstm state has converged by the time it reaches
+// its own range. The probabilities of the owned ranges are concatenated into
+// one track, which is then segmented in a single pass, so the result does not
+// depend on thread timing and speeches crossing a boundary are kept whole.
+class ShardedVad
+{
+public:
+    typedef std::function<std::unique_ptr<VadIterator>()> iterator_factory_t;
+
+private:
+    // Samples [begin, begin + length) of the file as a reader of its own
+    template <typename Reader>
+    struct shard_reader_t
+    {
+        const Reader &reader;
+        int64_t begin;
+        int64_t length;
+
+        int64_t num_samples() const
+        {
+            return length;
+        };
+
+        int64_t Read(int64_t offset, int64_t count, float *dst) const
+        {
+            return reader.Read(begin + offset, count, dst);
+        };
+
+        void Release(int64_t offset, int64_t count) const
+        {
+            reader.Release(begin + offset, count);
+        };
+    };
+
+public:
+    template <typename Reader>
+    void process(const Reader &reader)
+    {
+        static_assert(!is_sequential_reader<Reader>::value,
+            "shards are read from several threads, resample the file at the model rate first");
+        std::vector<std::unique_ptr<VadIterator>> iterators;
+        iterators.push_back(make_iterator());
+        const shard_plan_t plan(reader.num_samples(), iterators[0]->window_samples(), num_shards, warmup_samples);
+        const int shards = plan.shards();
+        while (static_cast<int>(iterators.size()) < shards)
+            iterators.push_back(make_iterator());
+
+        std::vector<ProbTrack> tracks(shards);
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            for (int k = next++; k < shards; k = next++) {
+                shard_reader_t<Reader> shard = { reader, plan.start[k] * plan.window, plan.length(k) * plan.window };
+                iterators[k]->record(&tracks[k]);
+                iterators[k]->process(shard, block_samples, [](const timestamp_t &) {});
+                iterators[k]->record(nullptr);
+            }
+        };
+        int workers = std::max(1, std::min(num_threads > 0 ? num_threads : static_cast<int>(std::thread::hardware_concurrency()), shards));
+        std::vector<std::thread> threads;
+        for (int i = 1; i < workers; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto &thread : threads)
+            thread.join();
+
+        plan.stitch(tracks, track, reports);
+        iterators[0]->process(track);
+        speeches = iterators[0]->get_speech_timestamps();
+    };
+
+    const std::vector<timestamp_t> &get_speech_timestamps() const
+    {
+        return speeches;
+    };
+
+    const std::vector<shard_report_t> &get_reports() const
+    {
+        return reports;
+    };
+
+    // Stitched probabilities of the whole file
+    const ProbTrack &get_track() const
+    {
+        return track;
+    };
+
+private:
+    iterator_factory_t make_iterator;
+    int num_shards;
+    int64_t warmup_samples;
+    int num_threads;
+    int64_t block_samples = 1 << 20; // Release() granularity of each shard
+
+    ProbTrack track;
+    std::vector<timestamp_t> speeches;
+    std::vector<shard_report_t> reports;
+
+public:
+    // Construction. Make_iterator builds one iterator per shard (share the model),
+    // all with the same segmentation parameters; Threads 0 means one per core.
+    ShardedVad(iterator_factory_t Make_iterator, int Shards, int64_t Warmup_samples, int Threads = 0)
+        : make_iterator(Make_iterator), num_shards(Shards), warmup_samples(Warmup_samples), num_threads(Threads)
+    {
+        if (num_shards <= 0)
+            throw std::invalid_argument("number of shards must be positive");
+    };
+};
+
+// The shards of one file as the rows of one batched invoke instead of threads:
+// every step infers the next window of all shards together, [B, context +
+// window] with state [2, B, 128], so a single core gets the throughput of the
+// batched GEMMs. B is the engine's max batch (the kmodel batch for nncase).
+// Stitching and reports are the same as ShardedVad.
+class TimeBatchedVad
+{
+public:
+    template <typename Reader>
+    void process(const Reader &reader)
+    {
+        static_assert(!is_sequential_reader<Reader>::value,
+            "shards are read in turn, resample the file at the model rate first");
+        const int64_t window = engine.window_samples();
+        const shard_plan_t plan(reader.num_samples(), window, engine.max_batch_size(), warmup_samples);
+        const int shards = plan.shards();
+
+        std::vector<ProbTrack> tracks(shards);
+        std::vector<int> ids(shards);
+        int64_t steps = 0;
+        for (int k = 0; k < shards; k++) {
+            ids[k] = engine.add_stream();
+            engine.record(ids[k], &tracks[k]);
+            steps = std::max(steps, plan.length(k));
+        }
+
+        // Shards are all as long as each other but for the warm-up the first one
+        // does not have, it simply joins the batch that many steps later.
+        // Windows are read straight into their batch rows, and every
+        // block_samples of each shard the consumed range is handed back.
+        const int64_t release_steps = std::max<int64_t>(1, block_samples / window);
+        std::vector<int64_t> released(shards, 0);
+        for (int64_t t = 0; t < steps; t++) {
+            for (int k = 0; k < shards; k++) {
+                int64_t skip = steps - plan.length(k);
+                if (t < skip)
+                    continue;
+                reader.Read((plan.start[k] + t - skip) * window, window, engine.queue_window(ids[k]));
+            }
+            engine.run();
+            if ((t + 1) % release_steps != 0 && t + 1 != steps)
+                continue;
+            for (int k = 0; k < shards; k++) {
+                int64_t done = std::max<int64_t>(0, t + 1 - (steps - plan.length(k)));
+                reader.Release((plan.start[k] + released[k]) * window, (done - released[k]) * window);
+                released[k] = done;
+            }
+        }
+
+        for (int k = 0; k < shards; k++) {
+            engine.record(ids[k], nullptr);
+            engine.remove_stream(ids[k]);
+        }
+        plan.stitch(tracks, track, reports);
+        speeches = engine.segment_track(track);
+    };
+
+    const std::vector<timestamp_t> &get_speech_timestamps() const
+    {
+        return speeches;
+    };
+
+    const std::vector<shard_report_t> &get_reports() const
+    {
+        return reports;
+    };
+
+    const ProbTrack &get_track() const
+    {
+        return track;
+    };
+
+private:
+    BatchedVadEngine &engine;
+    int64_t warmup_samples;
+    int64_t block_samples = 1 << 20; // Release() granularity of each shard
+
+    ProbTrack track;
+    std::vector<timestamp_t> speeches;
+    std::vector<shard_report_t> reports;
+
+public:
+    // Construction, the engine should have no streams of its own while processing
+    TimeBatchedVad(BatchedVadEngine &Engine, int64_t Warmup_samples)
+        : engine(Engine), warmup_samples(Warmup_samples)
+    {
+    };
+};
+
+#endif  // SILERO_SHARDED_VAD_H_
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "silero_vad_c.h"
+#include "vad_iterator.h"
+#include "batched_vad_engine.h"
+#if defined NATIVE
+#include "native_vad.h"
+#endif
+
+// The backend the library is built for
+#if defined ONNX
+typedef OnnxVadModel backend_model_t;
+typedef OnnxVadIterator backend_iterator_t;
+typedef OnnxBatchedVadEngine backend_engine_t;
+#elif defined NATIVE
+typedef NativeVadModel backend_model_t;
+typedef NativeVadIterator backend_iterator_t;
+typedef NativeBatchedVadEngine backend_engine_t;
+#else
+typedef NncaseVadModel backend_model_t;
+typedef NncaseVadIterator backend_iterator_t;
+typedef NncaseBatchedVadEngine backend_engine_t;
+#endif
+
+struct svad_model
+{
+    std::shared_ptr<backend_model_t> model;
+};
+
+struct svad_stream
+{
+    std::unique_ptr<VadIterator> vad;
+    std::vector<svad_event> events;
+    size_t events_head = 0; // popped so far
+    ProbTrack track;
+    size_t probs_head = 0;
+};
+
+struct svad_batch
+{
+    std::unique_ptr<BatchedVadEngine> engine;
+    std::vector<bool> live;                       // by stream id
+    std::vector<std::vector<vad_event_t>> events; // taken from the engine, not yet popped
+};
+
+static thread_local std::string last_error;
+
+// Runs body, turning any exception into an error code and last_error
+template <typename Body>
+static int guarded(Body body)
+{
+    try {
+        return body();
+    }
+    catch (const std::invalid_argument &e) {
+        last_error = e.what();
+        return SVAD_INVALID_ARGUMENT;
+    }
+    catch (const std::exception &e) {
+        last_error = e.what();
+        return SVAD_ERROR;
+    }
+    catch (...) {
+        last_error = "unknown error";
+        return SVAD_ERROR;
+    }
+}
+
+static int invalid(const char *message)
+{
+    last_error = message;
+    return SVAD_INVALID_ARGUMENT;
+}
+
+static svad_config read_config(const svad_config *config)
+{
+    svad_config result;
+    svad_config_init(&result);
+    if (config) {
+        if (config->size < offsetof(svad_config, keep_probs) || config->size > sizeof(svad_config))
+            throw std::invalid_argument("svad_config.size does not match this library");
+        std::memcpy(&result, config, config->size);
+        result.size = sizeof(svad_config);
+    }
+    if (result.sample_rate != 8000 && result.sample_rate != 16000)
+        throw std::invalid_argument("sample_rate must be 8000 or 16000");
+    return result;
+}
+
+static float max_speech(const svad_config &config)
+{
+    return config.max_speech_s > 0 ? config.max_speech_s : std::numeric_limits<float>::infinity();
+}
+
+static void queue_events(svad_stream *stream, const std::vector<vad_event_t> &events)
+{
+    for (const vad_event_t &event : events)
+        stream->events.push_back({ static_cast<int32_t>(event.type), event.sample });
+}
+
+extern "C" {
+
+int svad_version(void)
+{
+    return SVAD_VERSION;
+}
+
+const char *svad_last_error(void)
+{
+    return last_error.c_str();
+}
+
+void svad_config_init(svad_config *config)
+{
+    if (!config)
+        return;
+    config->size = sizeof(svad_config);
+    config->sample_rate = 16000;
+    config->window_ms = 32;
+    config->threshold = 0.5f;
+    config->min_silence_ms = 0;
+    config->speech_pad_ms = 32;
+    config->min_speech_ms = 32;
+    config->max_speech_s = 0;
+    config->keep_probs = 0;
+}
+
+svad_model *svad_model_create(const char *path)
+{
+    svad_model *model = nullptr;
+    if (!path) {
+        invalid("path is NULL");
+        return nullptr;
+    }
+    guarded([&]() {
+        std::unique_ptr<svad_model> created(new svad_model());
+        created->model = std::make_shared<backend_model_t>(path);
+        model = created.release();
+        return SVAD_OK;
+    });
+    return model;
+}
+
+void svad_model_destroy(svad_model *model)
+{
+    delete model;
+}
+
+svad_stream *svad_stream_create(svad_model *model, const svad_config *config)
+{
+    svad_stream *stream = nullptr;
+    if (!model) {
+        invalid("model is NULL");
+        return nullptr;
+    }
+    guarded([&]() {
+        svad_config c = read_config(config);
+        std::unique_ptr<svad_stream> created(new svad_stream());
+        created->vad.reset(new backend_iterator_t(model->model, c.sample_rate, c.window_ms, c.threshold,
+            c.min_silence_ms, c.speech_pad_ms, c.min_speech_ms, max_speech(c)));
+        if (c.keep_probs)
+            created->vad->record(&created->track);
+        stream = created.release();
+        return SVAD_OK;
+    });
+    return stream;
+}
+
+void svad_stream_destroy(svad_stream *stream)
+{
+    delete stream;
+}
+
+int svad_stream_push_f32(svad_stream *stream, const float *samples, size_t count)
+{
+    if (!stream || (!samples && count))
+        return invalid("stream or samples is NULL");
+    return guarded([&]() {
+        queue_events(stream, stream->vad->push(samples, count));
+        return SVAD_OK;
+    });
+}
+
+int svad_stream_push_s16(svad_stream *stream, const int16_t *samples, size_t count)
+{
+    if (!stream || (!samples && count))
+        return invalid("stream or samples is NULL");
+    return guarded([&]() {
+        queue_events(stream, stream->vad->push(samples, count));
+        return SVAD_OK;
+    });
+}
+
+int svad_stream_flush(svad_stream *stream)
+{
+    if (!stream)
+        return invalid("stream is NULL");
+    return guarded([&]() {
+        queue_events(stream, stream->vad->flush());
+        return SVAD_OK;
+    });
+}
+
+int svad_stream_reset(svad_stream *stream)
+{
+    if (!stream)
+        return invalid("stream is NULL");
+    return guarded([&]() {
+        stream->vad->reset();
+        stream->events.clear();
+        stream->events_head = 0;
+        stream->track.probs.clear();
+        stream->probs_head = 0;
+        return SVAD_OK;
+    });
+}
+
+size_t svad_stream_pop_events(svad_stream *stream, svad_event *out, size_t max)
+{
+    if (!stream || !out)
+        return 0;
+    size_t count = std::min(max, stream->events.size() - stream->events_head);
+    std::memcpy(out, stream->events.data() + stream->events_head, count * sizeof(svad_event));
+    stream->events_head += count;
+    if (stream->events_head == stream->events.size()) {
+        stream->events.clear();
+        stream->events_head = 0;
+    }
+    return count;
+}
+
+size_t svad_stream_pop_probs(svad_stream *stream, float *out, size_t max)
+{
+    if (!stream || !out)
+        return 0;
+    size_t count = std::min(max, stream->track.size() - stream->probs_head);
+    for (size_t i = 0; i < count; i++)
+        out[i] = stream->track.prob(stream->probs_head + i);
+    stream->probs_head += count;
+    if (stream->probs_head == stream->track.size()) {
+        stream->track.probs.clear();
+        stream->probs_head = 0;
+    }
+    return count;
+}
+
+size_t svad_stream_window_samples(const svad_stream *stream)
+{
+    return stream ? static_cast<size_t>(stream->vad->window_samples()) : 0;
+}
+
+svad_batch *svad_batch_create(svad_model *model, const svad_config *config, int max_batch)
+{
+    svad_batch *batch = nullptr;
+    if (!model) {
+        invalid("model is NULL");
+        return nullptr;
+    }
+    guarded([&]() {
+        svad_config c = read_config(config);
+        std::unique_ptr<svad_batch> created(new svad_batch());
+        created->engine.reset(new backend_engine_t(model->model, max_batch, c.sample_rate, c.window_ms, c.threshold,
+            c.min_silence_ms, c.speech_pad_ms, c.min_speech_ms, max_speech(c)));
+        batch = created.release();
+        return SVAD_OK;
+    });
+    return batch;
+}
+
+void svad_batch_destroy(svad_batch *batch)
+{
+    delete batch;
+}
+
+static bool live_stream(const svad_batch *batch, int id)
+{
+    return batch && id >= 0 && id < static_cast<int>(batch->live.size()) && batch->live[id];
+}
+
+int svad_batch_add_stream(svad_batch *batch)
+{
+    if (!batch)
+        return invalid("batch is NULL");
+    return guarded([&]() {
+        int id = batch->engine->add_stream();
+        if (id >= static_cast<int>(batch->live.size())) {
+            batch->live.resize(id + 1, false);
+            batch->events.resize(id + 1);
+        }
+        batch->live[id] = true;
+        batch->events[id].clear();
+        return id;
+    });
+}
+
+int svad_batch_remove_stream(svad_batch *batch, int id)
+{
+    if (!live_stream(batch, id))
+        return invalid("no such stream");
+    return guarded([&]() {
+        batch->engine->remove_stream(id);
+        batch->live[id] = false;
+        batch->events[id].clear();
+        return SVAD_OK;
+    });
+}
+
+int svad_batch_push_window(svad_batch *batch, int id, const float *window)
+{
+    if (!live_stream(batch, id) || !window)
+        return invalid("no such stream or window is NULL");
+    return guarded([&]() {
+        batch->engine->push_window(id, window);
+        return SVAD_OK;
+    });
+}
+
+int svad_batch_run(svad_batch *batch)
+{
+    if (!batch)
+        return invalid("batch is NULL");
+    return guarded([&]() { return batch->engine->run(); });
+}
+
+int svad_batch_finish_stream(svad_batch *batch, int id, int64_t audio_length)
+{
+    if (!live_stream(batch, id))
+        return invalid("no such stream");
+    return guarded([&]() {
+        batch->engine->finish_stream(id, audio_length);
+        return SVAD_OK;
+    });
+}
+
+size_t svad_batch_pop_events(svad_batch *batch, int id, svad_event *out, size_t max)
+{
+    if (!live_stream(batch, id) || !out)
+        return 0;
+    std::vector<vad_event_t> &events = batch->events[id];
+    batch->engine->take_events(id, events);
+    size_t count = std::min(max, events.size());
+    for (size_t i = 0; i < count; i++)
+        out[i] = { static_cast<int32_t>(events[i].type), events[i].sample };
+    events.erase(events.begin(), events.begin() + count);
+    return count;
+}
+
+size_t svad_batch_window_samples(const svad_batch *batch)
+{
+    return batch ? static_cast<size_t>(batch->engine->window_samples()) : 0;
+}
+
+}  // extern "C"
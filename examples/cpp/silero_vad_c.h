@@ -0,0 +1,122 @@
+#ifndef SILERO_VAD_C_H_
+#define SILERO_VAD_C_H_
+
+/*
+ * C interface of libsilerovad, for bindings in other languages. It wraps the
+ * C++ iterators and batched engine of whichever backend the library was built
+ * for (onnx runtime, nncase or the native engine), so every language gets the
+ * same inference and segmentation.
+ *
+ * Functions returning int give SVAD_OK or a negative error code, functions
+ * returning a pointer give NULL on error; svad_last_error() then describes
+ * the last error of the calling thread. No C++ exception crosses this API.
+ *
+ * A model may be shared by streams and batches on any number of threads; a
+ * stream or batch must only be used by one thread at a time.
+ *
+ * The ABI only grows: structs passed in are versioned by their size field.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define SVAD_API __declspec(dllexport)
+#else
+#define SVAD_API __attribute__((visibility("default")))
+#endif
+
+#define SVAD_VERSION 1
+
+enum svad_status
+{
+    SVAD_OK = 0,
+    SVAD_ERROR = -1,         /* runtime failure, see svad_last_error() */
+    SVAD_INVALID_ARGUMENT = -2,
+};
+
+typedef struct svad_model svad_model;
+typedef struct svad_stream svad_stream;
+typedef struct svad_batch svad_batch;
+
+/* Segmentation parameters, fill with svad_config_init() before changing any */
+typedef struct svad_config
+{
+    uint32_t size;              /* sizeof(svad_config) */
+    int32_t sample_rate;        /* 8000 or 16000 */
+    int32_t window_ms;          /* model window, 32 */
+    float threshold;
+    int32_t min_silence_ms;
+    int32_t speech_pad_ms;
+    int32_t min_speech_ms;
+    float max_speech_s;         /* <= 0 for no limit */
+    int32_t keep_probs;         /* non-zero: keep window probabilities for svad_stream_pop_probs() */
+} svad_config;
+
+enum svad_event_type
+{
+    SVAD_SPEECH_START = 0,
+    SVAD_SPEECH_END = 1,
+};
+
+typedef struct svad_event
+{
+    int32_t type;               /* svad_event_type */
+    int64_t sample;             /* from the start of the stream */
+} svad_event;
+
+SVAD_API int svad_version(void);
+SVAD_API const char *svad_last_error(void);
+SVAD_API void svad_config_init(svad_config *config);
+
+/* Model (onnx file or kmodel, by build), loaded once and shared */
+SVAD_API svad_model *svad_model_create(const char *path);
+SVAD_API void svad_model_destroy(svad_model *model);
+
+/*
+ * Live stream: push samples in chunks of any size, each completed window is
+ * inferred at once and the speech starts/ends it decides are queued until
+ * popped. A NULL config means the defaults. The model must outlive the stream.
+ */
+SVAD_API svad_stream *svad_stream_create(svad_model *model, const svad_config *config);
+SVAD_API void svad_stream_destroy(svad_stream *stream);
+SVAD_API int svad_stream_push_f32(svad_stream *stream, const float *samples, size_t count);
+SVAD_API int svad_stream_push_s16(svad_stream *stream, const int16_t *samples, size_t count);
+/* End of the audio: a speech still open ends here */
+SVAD_API int svad_stream_flush(svad_stream *stream);
+/* Start a new audio, dropping queued events and probabilities */
+SVAD_API int svad_stream_reset(svad_stream *stream);
+/* Moves up to max queued events to out, returns how many */
+SVAD_API size_t svad_stream_pop_events(svad_stream *stream, svad_event *out, size_t max);
+/* Moves up to max queued window probabilities (keep_probs) to out, returns how many */
+SVAD_API size_t svad_stream_pop_probs(svad_stream *stream, float *out, size_t max);
+SVAD_API size_t svad_stream_window_samples(const svad_stream *stream);
+
+/*
+ * Many streams through batched invokes: queue one whole window per stream,
+ * then run them all in one invoke. max_batch is the rows per invoke (the
+ * compiled batch of the kmodel for nncase).
+ */
+SVAD_API svad_batch *svad_batch_create(svad_model *model, const svad_config *config, int max_batch);
+SVAD_API void svad_batch_destroy(svad_batch *batch);
+/* Returns the id of a new stream, or a negative error code */
+SVAD_API int svad_batch_add_stream(svad_batch *batch);
+SVAD_API int svad_batch_remove_stream(svad_batch *batch, int id);
+/* window holds svad_batch_window_samples() samples; runs the batch first if full */
+SVAD_API int svad_batch_push_window(svad_batch *batch, int id, const float *window);
+/* Infers the queued windows, returns how many or a negative error code */
+SVAD_API int svad_batch_run(svad_batch *batch);
+/* End of a stream's audio after audio_length samples (< 0: its last window) */
+SVAD_API int svad_batch_finish_stream(svad_batch *batch, int id, int64_t audio_length);
+SVAD_API size_t svad_batch_pop_events(svad_batch *batch, int id, svad_event *out, size_t max);
+SVAD_API size_t svad_batch_window_samples(const svad_batch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SILERO_VAD_C_H_ */
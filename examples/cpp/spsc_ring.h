@@ -0,0 +1,219 @@
+#ifndef SILERO_SPSC_RING_H_
+#define SILERO_SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// How a side that cannot go on (consumer with too few samples, producer with
+// too little room) waits for the other one.
+enum class wait_policy_t
+{
+    spin,  // busy-wait, lowest latency, needs a core of its own per waiting side
+    yield, // busy-wait but give the core away between checks
+    block, // spin briefly, then sleep on a condition variable until woken
+};
+
+// Single-producer / single-consumer ring buffer of samples, e.g. between a
+// capture thread and the VAD thread. push() and pop() are wait-free: each side
+// owns one index, publishes it with a release store and reads the other side's
+// with an acquire load, refreshing a cached copy only when it looks full or
+// empty. The two indices and their caches sit on separate cache lines so the
+// sides never write to a line the other one reads on every call.
+// Exactly one thread may push and one thread may pop.
+template <typename T>
+class SpscRing
+{
+public:
+    typedef T value_type;
+
+    // Producer: copies up to count samples in, returns how many fitted
+    size_t push(const T *data, size_t count)
+    {
+        const size_t head = producer.index.load(std::memory_order_relaxed);
+        if (capacity - (head - producer.cached) < count)
+            producer.cached = consumer.index.load(std::memory_order_acquire);
+        count = std::min(count, capacity - (head - producer.cached));
+        if (count == 0)
+            return 0;
+        copy_in(head, data, count);
+        producer.index.store(head + count, std::memory_order_release);
+        wake(consumer_waiting);
+        return count;
+    };
+
+    // Producer: copies all count samples in, waiting for room as the policy says.
+    // Returns less only if the ring was closed meanwhile.
+    size_t push_wait(const T *data, size_t count)
+    {
+        size_t done = 0;
+        while (done < count) {
+            done += push(data + done, count - done);
+            if (done < count && !wait(producer_waiting, [&]() { return writable() > 0; }))
+                break;
+        }
+        return done;
+    };
+
+    // Consumer: copies up to count samples out, returns how many there were
+    size_t pop(T *dst, size_t count)
+    {
+        const size_t tail = consumer.index.load(std::memory_order_relaxed);
+        if (consumer.cached - tail < count)
+            consumer.cached = producer.index.load(std::memory_order_acquire);
+        count = std::min(count, consumer.cached - tail);
+        if (count == 0)
+            return 0;
+        copy_out(tail, dst, count);
+        consumer.index.store(tail + count, std::memory_order_release);
+        wake(producer_waiting);
+        return count;
+    };
+
+    // Consumer: waits as the policy says until min_count samples are there (at
+    // most capacity) and pops up to max_count of them. Returns fewer than
+    // min_count only once the ring is closed and drained.
+    size_t pop_wait(T *dst, size_t min_count, size_t max_count)
+    {
+        min_count = std::min(std::min(min_count, max_count), capacity);
+        wait(consumer_waiting, [&]() { return readable() >= min_count; });
+        return pop(dst, max_count);
+    };
+
+    // Producer: no more samples will come, wakes any waiting side
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> guard(lock);
+        wakeup.notify_all();
+    };
+
+    bool is_closed() const
+    {
+        return closed.load(std::memory_order_acquire);
+    };
+
+    // Samples the consumer can pop now
+    size_t readable() const
+    {
+        return producer.index.load(std::memory_order_acquire) - consumer.index.load(std::memory_order_relaxed);
+    };
+
+    // Room the producer can push into now
+    size_t writable() const
+    {
+        return capacity - (producer.index.load(std::memory_order_relaxed) - consumer.index.load(std::memory_order_acquire));
+    };
+
+    size_t size() const
+    {
+        return capacity;
+    };
+
+private:
+    // Indices run freely and wrap modulo the (power of two) capacity on access
+    struct alignas(64) side_t
+    {
+        std::atomic<size_t> index{0};
+        size_t cached = 0; // last seen index of the other side, touched by this side only
+    };
+
+    void copy_in(size_t head, const T *data, size_t count)
+    {
+        size_t at = head & mask;
+        size_t first = std::min(count, capacity - at);
+        std::memcpy(&buffer[at], data, first * sizeof(T));
+        std::memcpy(&buffer[0], data + first, (count - first) * sizeof(T));
+    };
+
+    void copy_out(size_t tail, T *dst, size_t count)
+    {
+        size_t at = tail & mask;
+        size_t first = std::min(count, capacity - at);
+        std::memcpy(dst, &buffer[at], first * sizeof(T));
+        std::memcpy(dst + first, &buffer[0], (count - first) * sizeof(T));
+    };
+
+    static void pause()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    };
+
+    // Returns false if the ring got closed before ready() held
+    template <typename Ready>
+    bool wait(std::atomic<bool> &waiting, Ready ready)
+    {
+        for (int i = 0; !ready(); i++) {
+            if (is_closed())
+                return ready();
+            if (policy == wait_policy_t::spin || (policy == wait_policy_t::block && i < spin_count))
+                pause();
+            else if (policy == wait_policy_t::yield)
+                std::this_thread::yield();
+            else {
+                // The flag is raised before the last check, and the other side
+                // publishes its index before looking at the flag, so a wake-up
+                // cannot fall between the two (both fences are seq_cst).
+                std::unique_lock<std::mutex> guard(lock);
+                waiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wakeup.wait(guard, [&]() { return ready() || is_closed(); });
+                waiting.store(false, std::memory_order_relaxed);
+            }
+        }
+        return true;
+    };
+
+    void wake(std::atomic<bool> &waiting)
+    {
+        if (policy != wait_policy_t::block)
+            return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(lock);
+            wakeup.notify_all();
+        }
+    };
+
+    side_t producer; // index: next sample to write
+    side_t consumer; // index: next sample to read
+    alignas(64) std::atomic<bool> producer_waiting{false};
+    std::atomic<bool> consumer_waiting{false};
+    std::atomic<bool> closed{false};
+
+    size_t capacity;
+    size_t mask;
+    std::vector<T> buffer;
+    wait_policy_t policy;
+    int spin_count = 256;  // pauses before a blocking side goes to sleep
+    std::mutex lock;      // only taken by a side going to sleep and to wake it
+    std::condition_variable wakeup;
+
+public:
+    // Construction, Capacity is rounded up to a power of two
+    explicit SpscRing(size_t Capacity, wait_policy_t Policy = wait_policy_t::block)
+        : policy(Policy)
+    {
+        if (Capacity == 0)
+            throw std::invalid_argument("ring capacity must be positive");
+        capacity = 1;
+        while (capacity < Capacity)
+            capacity <<= 1;
+        mask = capacity - 1;
+        buffer.resize(capacity);
+    };
+};
+
+#endif  // SILERO_SPSC_RING_H_
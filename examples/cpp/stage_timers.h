@@ -0,0 +1,240 @@
+#ifndef SILERO_STAGE_TIMERS_H_
+#define SILERO_STAGE_TIMERS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Per-stage latency of the window pipeline. Built with VAD_STAGE_TIMERS
+// (cmake -DBUILD_STAGE_TIMERS=ON), every VadIterator and BatchedVadEngine times
+// the stages below into one histogram each; without it VAD_STAGE() expands to
+// nothing and no timer, clock read or member exists at all.
+enum stage_t
+{
+    stage_input,   // window written to the model input (copy, read or int16 conversion)
+    stage_tensor,  // tensors created, bound or synced around the invoke
+    stage_infer,   // session Run / kmodel invoke / native forward
+    stage_state,   // state and context hand-off between windows
+    stage_segment, // segmentation state machine
+    stage_window,  // the whole window once its input is in: tensor to segment included
+    stage_count,
+};
+
+inline const char *stage_name(int stage)
+{
+    static const char *const names[stage_count] = {"input", "tensor", "infer", "state", "segment", "window"};
+    return stage >= 0 && stage < stage_count ? names[stage] : "unknown";
+}
+
+// Log-linear histogram of durations in ns, as HdrHistogram lays them out:
+// values below 2^sub_bits have a bucket each, above that every power of two is
+// split in 2^sub_bits buckets, so any value is known within 1/16 (6%) over
+// the whole range, up to 2^max_bits ns (18 min) where it saturates.
+class LatencyHistogram
+{
+public:
+    static const int sub_bits = 4;
+    static const int max_bits = 40;
+    static const int sub_count = 1 << sub_bits;
+    static const int bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+    void record(uint64_t ns)
+    {
+        counts[index(ns)]++;
+        total++;
+        sum += ns;
+        low = std::min(low, ns);
+        high = std::max(high, ns);
+    };
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < bucket_count; i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        low = std::min(low, other.low);
+        high = std::max(high, other.high);
+    };
+
+    void clear()
+    {
+        *this = LatencyHistogram();
+    };
+
+    uint64_t count() const { return total; };
+    uint64_t sum_ns() const { return sum; };
+    uint64_t min_ns() const { return total ? low : 0; };
+    uint64_t max_ns() const { return high; };
+    double mean_ns() const { return total ? static_cast<double>(sum) / total : 0.0; };
+    uint64_t bucket(int i) const { return counts[i]; };
+
+    // Smallest value the q-quantile is known to be below, within a bucket
+    uint64_t percentile(double q) const
+    {
+        if (total == 0)
+            return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * total + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < bucket_count; i++) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(std::max(upper(i), low), high);
+        }
+        return high;
+    };
+
+    static int index(uint64_t ns)
+    {
+        if (ns < static_cast<uint64_t>(sub_count))
+            return static_cast<int>(ns);
+        int msb = 63 - __builtin_clzll(ns);
+        if (msb > max_bits)
+            return bucket_count - 1;
+        return (msb - sub_bits + 1) * sub_count + static_cast<int>((ns >> (msb - sub_bits)) & (sub_count - 1));
+    };
+
+    // Largest value counted in bucket i
+    static uint64_t upper(int i)
+    {
+        if (i < sub_count)
+            return static_cast<uint64_t>(i);
+        int shift = i / sub_count - 1;
+        return ((static_cast<uint64_t>(sub_count + i % sub_count) + 1) << shift) - 1;
+    };
+
+private:
+    uint64_t counts[bucket_count] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t low = UINT64_MAX;
+    uint64_t high = 0;
+};
+
+// One histogram per stage, e.g. of an iterator or engine
+class StageTimers
+{
+public:
+    void record(int stage, uint64_t ns)
+    {
+        stages[stage].record(ns);
+    };
+
+    const LatencyHistogram &stage(int stage) const
+    {
+        return stages[stage];
+    };
+
+    void merge(const StageTimers &other)
+    {
+        for (int s = 0; s < stage_count; s++)
+            stages[s].merge(other.stages[s]);
+    };
+
+    void clear()
+    {
+        for (LatencyHistogram &histogram : stages)
+            histogram.clear();
+    };
+
+    // {"stage": {"count", "min_us", "mean_us", "p50_us", "p90_us", "p99_us",
+    // "p999_us", "max_us", "buckets": [[upper_ns, count], ...]}, ...}, the
+    // stages never timed and the empty buckets left out
+    void dump_json(std::ostream &out) const
+    {
+        out << "{";
+        bool first = true;
+        for (int s = 0; s < stage_count; s++) {
+            const LatencyHistogram &h = stages[s];
+            if (h.count() == 0)
+                continue;
+            out << (first ? "" : ",") << "\"" << stage_name(s) << "\":{\"count\":" << h.count()
+                << ",\"min_us\":" << h.min_ns() / 1e3 << ",\"mean_us\":" << h.mean_ns() / 1e3
+                << ",\"p50_us\":" << h.percentile(0.5) / 1e3 << ",\"p90_us\":" << h.percentile(0.9) / 1e3
+                << ",\"p99_us\":" << h.percentile(0.99) / 1e3 << ",\"p999_us\":" << h.percentile(0.999) / 1e3
+                << ",\"max_us\":" << h.max_ns() / 1e3 << ",\"buckets\":[";
+            bool first_bucket = true;
+            for (int i = 0; i < LatencyHistogram::bucket_count; i++) {
+                if (h.bucket(i) == 0)
+                    continue;
+                out << (first_bucket ? "" : ",") << "[" << LatencyHistogram::upper(i) << "," << h.bucket(i) << "]";
+                first_bucket = false;
+            }
+            out << "]}";
+            first = false;
+        }
+        out << "}";
+    };
+
+    // Prometheus text exposition: one histogram family `name` in seconds with a
+    // stage label, cumulative buckets at the non-empty bucket bounds. labels
+    // (e.g. `stream="3"`) are added to every sample; when several timers go
+    // to one family, only the first dump writes the header.
+    void dump_text(std::ostream &out, const std::string &name = "vad_stage_seconds", const std::string &labels = "",
+        bool header = true) const
+    {
+        const std::string extra = labels.empty() ? "" : "," + labels;
+        if (header) {
+            out << "# HELP " << name << " Latency of each stage of a VAD window.\n";
+            out << "# TYPE " << name << " histogram\n";
+        }
+        for (int s = 0; s < stage_count; s++) {
+            const LatencyHistogram &h = stages[s];
+            if (h.count() == 0)
+                continue;
+            const std::string stage = "stage=\"" + std::string(stage_name(s)) + "\"" + extra;
+            uint64_t cumulative = 0;
+            for (int i = 0; i < LatencyHistogram::bucket_count; i++) {
+                if (h.bucket(i) == 0)
+                    continue;
+                cumulative += h.bucket(i);
+                out << name << "_bucket{" << stage << ",le=\"" << (LatencyHistogram::upper(i) + 1) / 1e9 << "\"} "
+                    << cumulative << "\n";
+            }
+            out << name << "_bucket{" << stage << ",le=\"+Inf\"} " << h.count() << "\n";
+            out << name << "_sum{" << stage << "} " << h.sum_ns() / 1e9 << "\n";
+            out << name << "_count{" << stage << "} " << h.count() << "\n";
+        }
+    };
+
+private:
+    LatencyHistogram stages[stage_count];
+};
+
+#if defined VAD_STAGE_TIMERS
+
+// Times its scope into one stage
+class stage_scope_t
+{
+public:
+    stage_scope_t(StageTimers &Timers, int Stage)
+        : timers(Timers), stage(Stage), start(std::chrono::steady_clock::now())
+    {
+    };
+
+    ~stage_scope_t()
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        timers.record(stage, static_cast<uint64_t>(ns));
+    };
+
+private:
+    StageTimers &timers;
+    int stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define VAD_STAGE_CONCAT_(a, b) a##b
+#define VAD_STAGE_CONCAT(a, b) VAD_STAGE_CONCAT_(a, b)
+// Times the rest of the enclosing scope as stage of timers
+#define VAD_STAGE(timers, stage) stage_scope_t VAD_STAGE_CONCAT(stage_scope_, __LINE__)(timers, stage)
+
+#else
+
+#define VAD_STAGE(timers, stage) do {} while (0)
+
+#endif
+
+#endif  // SILERO_STAGE_TIMERS_H_
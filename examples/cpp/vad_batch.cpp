@@ -0,0 +1,63 @@
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include "file_batch.h"
+#if defined NATIVE
+#include "native_vad.h"
+#endif
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 7) {
+        std::cerr << "Usage: " << argv[0] << " model_file manifest_file|-|'glob' results.jsonl [threads] [rows] [sample_rate]" << std::endl;
+        std::cerr << "       rows > 0 packs files into the rows of batched invokes, all at sample_rate (16000)" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> files = read_manifest(argv[2]);
+    std::ofstream results(argv[3]);
+    if (!results) {
+        std::cerr << "cannot write " << argv[3] << std::endl;
+        return 1;
+    }
+
+    // One model for all workers, each worker builds its own iterators or engine on it
+    std::string path(argv[1]);
+    int threads = argc > 4 ? std::stoi(argv[4]) : 0;
+    int rows = argc > 5 ? std::stoi(argv[5]) : 0;
+    int sample_rate = argc > 6 ? std::stoi(argv[6]) : 16000;
+#if defined ONNX
+    auto model = std::make_shared<OnnxVadModel>(path);
+    FileBatchVad batch([&](int sample_rate) { return std::unique_ptr<VadIterator>(new OnnxVadIterator(model, sample_rate)); }, threads);
+    PackedFileVad packed([&]() { return std::unique_ptr<BatchedVadEngine>(new OnnxBatchedVadEngine(model, rows, sample_rate)); }, threads);
+#elif defined NATIVE
+    auto model = std::make_shared<NativeVadModel>(path);
+    FileBatchVad batch([&](int sample_rate) { return std::unique_ptr<VadIterator>(new NativeVadIterator(model, sample_rate)); }, threads);
+    PackedFileVad packed([&]() { return std::unique_ptr<BatchedVadEngine>(new NativeBatchedVadEngine(model, rows, sample_rate)); }, threads);
+#else
+    auto model = std::make_shared<NncaseVadModel>(path);
+    FileBatchVad batch([&](int sample_rate) { return std::unique_ptr<VadIterator>(new NncaseVadIterator(model, sample_rate)); }, threads);
+    PackedFileVad packed([&]() { return std::unique_ptr<BatchedVadEngine>(new NncaseBatchedVadEngine(model, rows, sample_rate)); }, threads);
+#endif
+    if (rows > 0)
+        packed.process(files, results);
+    else
+        batch.process(files, results);
+
+    const batch_stats_t &stats = rows > 0 ? packed.get_stats() : batch.get_stats();
+    std::cout << "files=" << stats.files
+              << " failed=" << stats.failed
+              << " audio_s=" << stats.audio_seconds
+              << " wall_s=" << stats.wall_seconds
+              << " files_per_s=" << stats.files / stats.wall_seconds
+              << " rtf=" << stats.wall_seconds / stats.audio_seconds
+              << " cpu_rtf=" << stats.cpu_seconds / stats.audio_seconds
+              << " p50_ms=" << stats.latency(0.5) * 1e3
+              << " p90_ms=" << stats.latency(0.9) * 1e3
+              << " p99_ms=" << stats.latency(0.99) * 1e3
+              << " p999_ms=" << stats.latency(0.999) * 1e3
+              << " max_ms=" << stats.latency(1.0) * 1e3
+              << std::endl;
+    return stats.failed == stats.files && stats.files > 0 ? 1 : 0;
+}
@@ -0,0 +1,977 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sys/resource.h>
+#include "wav.h"
+#include "vad_iterator.h"
+#include "sharded_vad.h"
+#include "spsc_ring.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#if defined NATIVE
+#include "native_vad.h"
+#endif
+#include "bench_suite.h"
+
+// CPU seconds (user + system) used by the whole process so far
+static double cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+        + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+// Discards std::cout while alive, VadIterator::process reports every call
+class mute_cout
+{
+public:
+    mute_cout() : buf(std::cout.rdbuf(nullptr)) {}
+    ~mute_cout()
+    {
+        std::cout.rdbuf(buf);
+        std::cout.clear();
+    }
+
+private:
+    std::streambuf *buf;
+};
+
+#if defined ONNX
+// Every stream runs on its own thread with its own iterator over one shared model
+static void bench_threads(const std::vector<float> &input_wav, int sample_rate,
+    const std::string &model_path, const OnnxThreadingPolicy &policy, int num_streams)
+{
+    auto model = std::make_shared<OnnxVadModel>(model_path, policy);
+    std::vector<std::unique_ptr<OnnxVadIterator>> streams;
+    for (int i = 0; i < num_streams; i++)
+        streams.emplace_back(new OnnxVadIterator(model, sample_rate));
+
+    double cpu_start = cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    {
+        mute_cout mute;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < num_streams; i++)
+            workers.emplace_back([&, i]() { streams[i]->process(input_wav); });
+        for (auto &worker : workers)
+            worker.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double cpu = cpu_seconds() - cpu_start;
+
+    double audio = static_cast<double>(input_wav.size()) / sample_rate * num_streams;
+    std::cout << "streams=" << num_streams
+              << " pools=" << (policy.global_pools ? "global" : "session")
+              << " intra=" << policy.intra_threads
+              << " inter=" << policy.inter_threads
+              << " spin=" << policy.allow_spinning
+              << " wall_s=" << wall
+              << " audio_s_per_s=" << audio / wall
+              << " cpu_cores=" << cpu / wall
+              << " cpu_s_per_audio_s=" << cpu / audio
+              << std::endl;
+}
+#endif
+
+// Iterator of whichever backend this binary is built for
+static std::unique_ptr<VadIterator> make_iterator(const std::string &model_path, int sample_rate, int min_silence_ms = 0)
+{
+#if defined ONNX
+    return std::unique_ptr<VadIterator>(new OnnxVadIterator(model_path, sample_rate, 32, 0.5, min_silence_ms));
+#elif defined NATIVE
+    return std::unique_ptr<VadIterator>(new NativeVadIterator(model_path, sample_rate, 32, 0.5, min_silence_ms));
+#else
+    return std::unique_ptr<VadIterator>(new NncaseVadIterator(model_path, sample_rate, 32, 0.5, min_silence_ms));
+#endif
+}
+
+// Infer once into a probability track, then time re-segmentation over a parameter grid
+static void bench_track(const wav::WavChannelReader &reader, const std::string &model_path, const std::string &track_path)
+{
+    auto vad = make_iterator(model_path, reader.sample_rate());
+    ProbTrack track;
+    vad->record(&track);
+    auto start = std::chrono::steady_clock::now();
+    {
+        mute_cout mute;
+        vad->process(reader);
+    }
+    double infer_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    vad->record(nullptr);
+    track.save(track_path);
+
+    ProbTrack loaded;
+    loaded.load(track_path);
+    double hours = static_cast<double>(loaded.audio_length_samples) / loaded.sample_rate / 3600;
+    std::cout << "windows=" << loaded.size() << " track_bytes=" << loaded.size()
+              << " infer_s=" << infer_s << std::endl;
+
+    for (float threshold : {0.3f, 0.5f, 0.7f}) {
+        for (int min_silence_ms : {0, 100, 300}) {
+            for (int speech_pad_ms : {0, 30}) {
+                VadIterator segmenter(loaded.sample_rate, static_cast<int>(loaded.window_size_samples * 1000 / loaded.sample_rate),
+                    threshold, min_silence_ms, speech_pad_ms);
+                const int reps = 20;
+                auto t0 = std::chrono::steady_clock::now();
+                for (int i = 0; i < reps; i++)
+                    segmenter.process(loaded);
+                double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / reps;
+                std::cout << "threshold=" << threshold
+                          << " min_silence_ms=" << min_silence_ms
+                          << " speech_pad_ms=" << speech_pad_ms
+                          << " speeches=" << segmenter.get_speech_timestamps().size()
+                          << " us=" << us
+                          << " us_per_audio_hour=" << us / hours
+                          << std::endl;
+            }
+        }
+    }
+}
+
+// One file split over shards on threads, against the plain sequential run
+static void bench_shards(const wav::WavChannelReader &reader, const std::string &model_path, int shards, int warmup_ms, int threads)
+{
+    auto sequential = make_iterator(model_path, reader.sample_rate());
+    auto start = std::chrono::steady_clock::now();
+    {
+        mute_cout mute;
+        sequential->process(reader);
+    }
+    double sequential_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#if defined ONNX
+    auto model = std::make_shared<OnnxVadModel>(model_path);
+    ShardedVad sharded([&]() { return std::unique_ptr<VadIterator>(new OnnxVadIterator(model, reader.sample_rate())); },
+#elif defined NATIVE
+    auto model = std::make_shared<NativeVadModel>(model_path);
+    ShardedVad sharded([&]() { return std::unique_ptr<VadIterator>(new NativeVadIterator(model, reader.sample_rate())); },
+#else
+    auto model = std::make_shared<NncaseVadModel>(model_path);
+    ShardedVad sharded([&]() { return std::unique_ptr<VadIterator>(new NncaseVadIterator(model, reader.sample_rate())); },
+#endif
+        shards, static_cast<int64_t>(warmup_ms) * reader.sample_rate() / 1000, threads);
+    start = std::chrono::steady_clock::now();
+    sharded.process(reader);
+    double sharded_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "shards=" << shards << " warmup_ms=" << warmup_ms
+              << " sequential_s=" << sequential_s << " sharded_s=" << sharded_s
+              << " speedup=" << sequential_s / sharded_s
+              << " speeches=" << sharded.get_speech_timestamps().size()
+              << " sequential_speeches=" << sequential->get_speech_timestamps().size()
+              << " same=" << (sharded.get_speech_timestamps() == sequential->get_speech_timestamps())
+              << std::endl;
+    for (const shard_report_t &report : sharded.get_reports()) {
+        std::cout << "boundary=" << report.boundary_sample
+                  << " overlap_windows=" << report.overlap_windows
+                  << " max_div=" << report.max_divergence
+                  << " mean_div=" << report.mean_divergence
+                  << " boundary_div=" << report.boundary_divergence
+                  << " converged_after=" << report.converged_after
+                  << std::endl;
+    }
+}
+
+// One file as shards in the rows of one batched invoke, against the sequential run
+static void bench_timebatch(const wav::WavChannelReader &reader, const std::string &model_path, int rows, int warmup_ms)
+{
+    auto sequential = make_iterator(model_path, reader.sample_rate());
+    auto start = std::chrono::steady_clock::now();
+    {
+        mute_cout mute;
+        sequential->process(reader);
+    }
+    double sequential_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#if defined ONNX
+    OnnxBatchedVadEngine engine(model_path, rows, reader.sample_rate());
+#elif defined NATIVE
+    NativeBatchedVadEngine engine(model_path, rows, reader.sample_rate());
+#else
+    NncaseBatchedVadEngine engine(model_path, rows, reader.sample_rate());
+#endif
+    TimeBatchedVad batched(engine, static_cast<int64_t>(warmup_ms) * reader.sample_rate() / 1000);
+    start = std::chrono::steady_clock::now();
+    batched.process(reader);
+    double batched_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double audio_s = static_cast<double>(reader.num_samples()) / reader.sample_rate();
+    std::cout << "rows=" << rows << " warmup_ms=" << warmup_ms
+              << " sequential_s=" << sequential_s << " batched_s=" << batched_s
+              << " speedup=" << sequential_s / batched_s
+              << " rtf=" << batched_s / audio_s
+              << " speeches=" << batched.get_speech_timestamps().size()
+              << " sequential_speeches=" << sequential->get_speech_timestamps().size()
+              << " same=" << (batched.get_speech_timestamps() == sequential->get_speech_timestamps())
+              << std::endl;
+    for (const shard_report_t &report : batched.get_reports()) {
+        std::cout << "boundary=" << report.boundary_sample
+                  << " overlap_windows=" << report.overlap_windows
+                  << " max_div=" << report.max_divergence
+                  << " mean_div=" << report.mean_divergence
+                  << " converged_after=" << report.converged_after
+                  << std::endl;
+    }
+}
+
+// What live code tends to bolt on without a ring: a mutex, a deque and a
+// condition variable, with the same interface as SpscRing for bench_handoff
+class mutex_queue_t
+{
+public:
+    typedef int16_t value_type;
+
+    size_t push_wait(const int16_t *data, size_t count)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.insert(queue.end(), data, data + count);
+        ready.notify_one();
+        return count;
+    }
+
+    size_t pop_wait(int16_t *dst, size_t min_count, size_t max_count)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.wait(guard, [&]() { return queue.size() >= min_count || closed; });
+        size_t count = std::min(max_count, queue.size());
+        std::copy(queue.begin(), queue.begin() + count, dst);
+        queue.erase(queue.begin(), queue.begin() + count);
+        return count;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        ready.notify_one();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<int16_t> queue;
+    bool closed = false;
+};
+
+// A capture thread pushes int16 chunks paced at speed x real time, the VAD
+// thread pops whole windows and infers them. Latency is from the start of the
+// push completing a window to the pop returning it, inference of the previous
+// window included.
+template <typename Queue>
+static void bench_handoff(Queue &queue, const char *name, const std::vector<int16_t> &pcm, VadIterator &vad,
+    int sample_rate, int chunk_ms, double speed)
+{
+    const size_t chunk = static_cast<size_t>(sample_rate) * chunk_ms / 1000;
+    const size_t window = vad.window_samples();
+    const size_t chunks = pcm.size() / chunk;
+    std::vector<int64_t> push_ns(chunks); // written before the push, read after the pop that follows it
+
+    auto start = std::chrono::steady_clock::now();
+    auto ns = [&]() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(); };
+    std::thread producer([&]() {
+        for (size_t i = 0; i < chunks; i++) {
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(i * chunk_ms / 1000.0 / speed));
+            push_ns[i] = ns();
+            queue.push_wait(&pcm[i * chunk], chunk);
+        }
+        queue.close();
+    });
+
+    std::vector<double> latencies;
+    latencies.reserve(pcm.size() / window);
+    std::vector<int16_t> buffer(window);
+    size_t popped = 0;
+    vad.reset();
+    double cpu_start = cpu_seconds();
+    while (queue.pop_wait(buffer.data(), window, window) == window) {
+        popped += window;
+        latencies.push_back((ns() - push_ns[(popped - 1) / chunk]) * 1e-3);
+        vad.push(buffer.data(), window);
+    }
+    double cpu = cpu_seconds() - cpu_start;
+    producer.join();
+    vad.flush();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) { return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(q * (latencies.size() - 1))]; };
+    std::cout << "queue=" << name << " chunk_ms=" << chunk_ms << " speed=" << speed
+              << " windows=" << latencies.size()
+              << " p50_us=" << at(0.5) << " p99_us=" << at(0.99) << " p999_us=" << at(0.999)
+              << " max_us=" << at(1.0)
+              << " cpu_s=" << cpu
+              << std::endl;
+}
+
+static void bench_ring(const wav::WavChannelReader &reader, const std::vector<float> &input_wav, const std::string &model_path,
+    int chunk_ms, double speed, double seconds)
+{
+    size_t samples = std::min(input_wav.size(), static_cast<size_t>(seconds * reader.sample_rate()));
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++)
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, input_wav[i] * 32768)));
+    auto vad = make_iterator(model_path, reader.sample_rate());
+    const size_t capacity = static_cast<size_t>(reader.sample_rate()); // one second
+
+    for (wait_policy_t policy : {wait_policy_t::spin, wait_policy_t::yield, wait_policy_t::block}) {
+        SpscRing<int16_t> ring(capacity, policy);
+        const char *name = policy == wait_policy_t::spin ? "spsc_spin" : policy == wait_policy_t::yield ? "spsc_yield" : "spsc_block";
+        bench_handoff(ring, name, pcm, *vad, reader.sample_rate(), chunk_ms, speed);
+    }
+    mutex_queue_t queue;
+    bench_handoff(queue, "mutex_deque", pcm, *vad, reader.sample_rate(), chunk_ms, speed);
+}
+
+// Per-stage latency of a file run and of a live run in 20 ms int16 chunks,
+// needs a build with stage timers
+static int bench_stages(const wav::WavChannelReader &reader, const std::string &model_path, const std::string &format)
+{
+#if defined VAD_STAGE_TIMERS
+    auto file = make_iterator(model_path, reader.sample_rate());
+    {
+        mute_cout mute;
+        file->process(reader);
+    }
+
+    std::vector<float> samples(reader.num_samples());
+    reader.Read(0, samples.size(), samples.data());
+    std::vector<int16_t> pcm(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, samples[i] * 32768)));
+    auto live = make_iterator(model_path, reader.sample_rate());
+    const size_t chunk = static_cast<size_t>(reader.sample_rate()) / 50;
+    for (size_t i = 0; i < pcm.size(); i += chunk)
+        live->push(&pcm[i], std::min(chunk, pcm.size() - i));
+    live->flush();
+
+    if (format == "text") {
+        file->get_stage_timers().dump_text(std::cout, "vad_stage_seconds", "run=\"file\"");
+        live->get_stage_timers().dump_text(std::cout, "vad_stage_seconds", "run=\"live\"", false);
+    }
+    else {
+        std::cout << "{\"file\":";
+        file->get_stage_timers().dump_json(std::cout);
+        std::cout << ",\"live\":";
+        live->get_stage_timers().dump_json(std::cout);
+        std::cout << "}" << std::endl;
+    }
+    return 0;
+#else
+    (void)reader;
+    (void)model_path;
+    (void)format;
+    std::cerr << "stages benchmark needs a build with -DBUILD_STAGE_TIMERS=ON" << std::endl;
+    return 1;
+#endif
+}
+
+// How far the speeches of a run are from the reference speeches: every
+// reference speech is matched to the run's speech overlapping it most, and the
+// start and end drift of the matched ones is averaged and maxed
+struct drift_t
+{
+    int64_t matched = 0;
+    int64_t missed = 0; // reference speeches no speech of the run overlaps
+    double mean_ms = 0;
+    double max_ms = 0;
+};
+
+static drift_t timestamp_drift(const std::vector<timestamp_t> &reference, const std::vector<timestamp_t> &run, int sample_rate)
+{
+    drift_t drift;
+    double sum = 0;
+    for (const timestamp_t &speech : reference) {
+        const timestamp_t *best = nullptr;
+        int64_t best_overlap = 0;
+        for (const timestamp_t &other : run) {
+            int64_t overlap = std::min(speech.end, other.end) - std::max(speech.start, other.start);
+            if (overlap > best_overlap) {
+                best_overlap = overlap;
+                best = &other;
+            }
+        }
+        if (!best) {
+            drift.missed++;
+            continue;
+        }
+        drift.matched++;
+        for (int64_t diff : {best->start - speech.start, best->end - speech.end}) {
+            double ms = std::abs(static_cast<double>(diff)) * 1000 / sample_rate;
+            sum += ms;
+            drift.max_ms = std::max(drift.max_ms, ms);
+        }
+    }
+    drift.mean_ms = drift.matched ? sum / (2 * drift.matched) : 0.0;
+    return drift;
+}
+
+// Energy gate against always-on inference on the same files: CPU saved and
+// timestamp drift for each state policy. Speeches are merged over 100 ms of
+// silence as an application would, not split at every pause of the model.
+static void bench_gate(const std::string &wav_list, const std::string &model_path, float floor_db)
+{
+    const int min_silence_ms = 100;
+    for (const std::string &file : bench::split_list(wav_list)) {
+        wav::MappedWavReader wav_file(file);
+        wav::WavChannelReader reader(wav_file);
+        auto reference = make_iterator(model_path, reader.sample_rate(), min_silence_ms);
+        double cpu = cpu_seconds();
+        {
+            mute_cout mute;
+            reference->process(reader);
+        }
+        double reference_cpu = cpu_seconds() - cpu;
+        const std::vector<timestamp_t> expected = reference->get_speech_timestamps();
+
+        const std::pair<const char *, gate_state_t> policies[] = {
+            {"hold", gate_state_t::hold}, {"decay", gate_state_t::decay}, {"refresh", gate_state_t::refresh}};
+        for (const auto &policy : policies) {
+            EnergyGatePolicy gate;
+            gate.floor_db = floor_db;
+            gate.noise_db = floor_db + 15;
+            gate.state = policy.second;
+            auto vad = make_iterator(model_path, reader.sample_rate(), min_silence_ms);
+            vad->set_energy_gate(gate);
+            cpu = cpu_seconds();
+            {
+                mute_cout mute;
+                vad->process(reader);
+            }
+            double gated_cpu = cpu_seconds() - cpu;
+            const gate_stats_t &stats = vad->get_gate_stats();
+            drift_t drift = timestamp_drift(expected, vad->get_speech_timestamps(), reader.sample_rate());
+            std::cout << "file=" << bench::base_name(file)
+                      << " policy=" << policy.first
+                      << " windows=" << stats.windows
+                      << " skipped_pct=" << 100.0 * stats.skipped / std::max<int64_t>(stats.windows, 1)
+                      << " cpu_s=" << gated_cpu
+                      << " always_on_cpu_s=" << reference_cpu
+                      << " cpu_saved_pct=" << 100.0 * (1 - gated_cpu / reference_cpu)
+                      << " speeches=" << vad->get_speech_timestamps().size()
+                      << " always_on_speeches=" << expected.size()
+                      << " missed=" << drift.missed
+                      << " mean_drift_ms=" << drift.mean_ms
+                      << " max_drift_ms=" << drift.max_ms
+                      << std::endl;
+        }
+    }
+}
+
+// Adaptive inference rate against always-on inference, for both back-off
+// policies at the given stride: CPU saved, returns to full rate and drift
+static void bench_rate(const std::string &wav_list, const std::string &model_path, int stride, int idle_windows)
+{
+    const int min_silence_ms = 100;
+    for (const std::string &file : bench::split_list(wav_list)) {
+        wav::MappedWavReader wav_file(file);
+        wav::WavChannelReader reader(wav_file);
+        auto reference = make_iterator(model_path, reader.sample_rate(), min_silence_ms);
+        double cpu = cpu_seconds();
+        {
+            mute_cout mute;
+            reference->process(reader);
+        }
+        double reference_cpu = cpu_seconds() - cpu;
+        const std::vector<timestamp_t> expected = reference->get_speech_timestamps();
+
+        const std::pair<const char *, rate_backoff_t> policies[] = {
+            {"fixed", rate_backoff_t::fixed}, {"exponential", rate_backoff_t::exponential}};
+        for (const auto &policy : policies) {
+            AdaptiveRatePolicy rate;
+            rate.idle_windows = idle_windows;
+            rate.stride = stride;
+            rate.backoff = policy.second;
+            auto vad = make_iterator(model_path, reader.sample_rate(), min_silence_ms);
+            vad->set_adaptive_rate(rate);
+            cpu = cpu_seconds();
+            {
+                mute_cout mute;
+                vad->process(reader);
+            }
+            double rate_cpu = cpu_seconds() - cpu;
+            const rate_stats_t &stats = vad->get_rate_stats();
+            drift_t drift = timestamp_drift(expected, vad->get_speech_timestamps(), reader.sample_rate());
+            std::cout << "file=" << bench::base_name(file)
+                      << " backoff=" << policy.first
+                      << " stride=" << stride
+                      << " idle_windows=" << idle_windows
+                      << " windows=" << stats.windows
+                      << " skipped_pct=" << 100.0 * stats.skipped / std::max<int64_t>(stats.windows, 1)
+                      << " wakeups=" << stats.wakeups
+                      << " max_stride=" << stats.max_stride
+                      << " cpu_s=" << rate_cpu
+                      << " always_on_cpu_s=" << reference_cpu
+                      << " cpu_saved_pct=" << 100.0 * (1 - rate_cpu / reference_cpu)
+                      << " speeches=" << vad->get_speech_timestamps().size()
+                      << " always_on_speeches=" << expected.size()
+                      << " missed=" << drift.missed
+                      << " mean_drift_ms=" << drift.mean_ms
+                      << " max_drift_ms=" << drift.max_ms
+                      << std::endl;
+        }
+    }
+}
+
+// Cost of the resampler front-end: the file (at a model rate) is resampled to
+// input_rate once to stand for a 48 / 44.1 kHz source, then pushed in 20 ms
+// float chunks through an iterator resampling it back, against the resampler
+// alone and the iterator at the model rate
+static void bench_resample(const wav::WavChannelReader &reader, const std::vector<float> &input_wav,
+    const std::string &model_path, int input_rate)
+{
+    const int model_rate = reader.sample_rate();
+    std::vector<float> source;
+    {
+        PolyphaseResampler up(model_rate, input_rate);
+        source.resize(up.max_output(input_wav.size()) + up.max_output(up.taps()));
+        size_t produced = up.process(input_wav.data(), input_wav.size(), source.data());
+        produced += up.flush(source.data() + produced);
+        source.resize(produced);
+    }
+    const size_t chunk = static_cast<size_t>(input_rate) / 50;
+
+    PolyphaseResampler alone(input_rate, model_rate);
+    std::vector<float> out(alone.max_output(chunk));
+    double cpu = cpu_seconds();
+    for (size_t i = 0; i < source.size(); i += chunk)
+        alone.process(&source[i], std::min(chunk, source.size() - i), out.data());
+    double resample_cpu = cpu_seconds() - cpu;
+
+    auto resampling = make_iterator(model_path, model_rate);
+    resampling->set_input_rate(input_rate);
+    cpu = cpu_seconds();
+    for (size_t i = 0; i < source.size(); i += chunk)
+        resampling->push(&source[i], std::min(chunk, source.size() - i));
+    resampling->flush();
+    double pipeline_cpu = cpu_seconds() - cpu;
+
+    auto direct = make_iterator(model_path, model_rate);
+    const size_t model_chunk = static_cast<size_t>(model_rate) / 50;
+    cpu = cpu_seconds();
+    for (size_t i = 0; i < input_wav.size(); i += model_chunk)
+        direct->push(&input_wav[i], std::min(model_chunk, input_wav.size() - i));
+    direct->flush();
+    double direct_cpu = cpu_seconds() - cpu;
+
+    drift_t drift = timestamp_drift(direct->get_speech_timestamps(), resampling->get_speech_timestamps(), model_rate);
+    double audio_s = static_cast<double>(source.size()) / input_rate;
+    std::cout << "input_rate=" << input_rate << " model_rate=" << model_rate << " taps=" << alone.taps()
+              << " audio_s=" << audio_s
+              << " resample_us_per_s=" << resample_cpu * 1e6 / audio_s
+              << " pipeline_cpu_s=" << pipeline_cpu
+              << " model_rate_cpu_s=" << direct_cpu
+              << " resample_share_pct=" << 100.0 * resample_cpu / pipeline_cpu
+              << " speeches=" << resampling->get_speech_timestamps().size()
+              << " model_rate_speeches=" << direct->get_speech_timestamps().size()
+              << " mean_drift_ms=" << drift.mean_ms
+              << " max_drift_ms=" << drift.max_ms << std::endl;
+}
+
+// Every channel of a wav (agent / customer of a call) through one batched
+// invoke per window, against one iterator per channel, plus the cost of
+// splitting and downmixing the interleaved PCM: fused into the window reads,
+// against a float copy of the interleaved frames and a scalar pass over it
+static void bench_channels(const std::string &wav_path, const std::string &model_path, int rows)
+{
+    wav::MappedWavReader reader(wav_path);
+    const int channels = reader.num_channel();
+    const int sample_rate = reader.sample_rate();
+    const double audio_s = static_cast<double>(reader.num_samples()) / sample_rate;
+
+#if defined ONNX
+    OnnxBatchedVadEngine engine(model_path, rows, sample_rate);
+#elif defined NATIVE
+    NativeBatchedVadEngine engine(model_path, rows, sample_rate);
+#else
+    NncaseBatchedVadEngine engine(model_path, rows, sample_rate);
+#endif
+    double cpu = cpu_seconds();
+    std::vector<std::vector<timestamp_t>> batched = engine.process_channels(reader);
+    double batched_cpu = cpu_seconds() - cpu;
+
+    std::vector<std::vector<timestamp_t>> sequential(channels);
+    cpu = cpu_seconds();
+    for (int c = 0; c < channels; c++) {
+        auto vad = make_iterator(model_path, sample_rate);
+        mute_cout mute;
+        vad->process(wav::WavChannelReader(reader, c));
+        sequential[c] = vad->get_speech_timestamps();
+    }
+    double sequential_cpu = cpu_seconds() - cpu;
+
+    // Window sized reads over the whole file, a few passes to be measurable
+    const int64_t window = sample_rate / 1000 * 32;
+    const int passes = 10;
+    std::vector<float> planes(channels * window), interleaved(channels * window), mono(window);
+    std::vector<float *> targets(channels);
+    for (int c = 0; c < channels; c++)
+        targets[c] = &planes[c * window];
+    const int64_t frames = reader.num_samples() / window * window;
+
+    cpu = cpu_seconds();
+    for (int p = 0; p < passes; p++)
+        for (int64_t offset = 0; offset < frames; offset += window)
+            reader.ReadChannels(offset, window, targets.data());
+    double split_cpu = cpu_seconds() - cpu;
+
+    cpu = cpu_seconds();
+    for (int p = 0; p < passes; p++)
+        for (int64_t offset = 0; offset < frames; offset += window)
+            reader.ReadDownmix(offset, window, mono.data());
+    double downmix_cpu = cpu_seconds() - cpu;
+
+    cpu = cpu_seconds();
+    for (int p = 0; p < passes; p++)
+        for (int64_t offset = 0; offset < frames; offset += window) {
+            reader.Read(offset * channels, window * channels, interleaved.data());
+            for (int64_t i = 0; i < window; i++)
+                for (int c = 0; c < channels; c++)
+                    targets[c][i] = interleaved[i * channels + c];
+        }
+    double naive_split_cpu = cpu_seconds() - cpu;
+
+    cpu = cpu_seconds();
+    for (int p = 0; p < passes; p++)
+        for (int64_t offset = 0; offset < frames; offset += window) {
+            reader.Read(offset * channels, window * channels, interleaved.data());
+            for (int64_t i = 0; i < window; i++) {
+                float sum = 0.0f;
+                for (int c = 0; c < channels; c++)
+                    sum += interleaved[i * channels + c];
+                mono[i] = sum / channels;
+            }
+        }
+    double naive_downmix_cpu = cpu_seconds() - cpu;
+
+    const double scale = 1e6 / (audio_s * passes);
+    std::cout << "channels=" << channels << " rows=" << rows << " audio_s=" << audio_s
+              << " batched_cpu_s=" << batched_cpu << " sequential_cpu_s=" << sequential_cpu
+              << " speedup=" << sequential_cpu / batched_cpu
+              << " split_us_per_s=" << split_cpu * scale
+              << " naive_split_us_per_s=" << naive_split_cpu * scale
+              << " downmix_us_per_s=" << downmix_cpu * scale
+              << " naive_downmix_us_per_s=" << naive_downmix_cpu * scale << std::endl;
+    for (int c = 0; c < channels; c++)
+        std::cout << "channel=" << c << " speeches=" << batched[c].size()
+                  << " sequential_speeches=" << sequential[c].size()
+                  << " same=" << (batched[c] == sequential[c]) << std::endl;
+}
+
+// The same audio in several WAV encodings (24 bit, G.711, float, RF64, ...):
+// decode cost per second of audio in window sized reads, and the speeches of
+// each against those of the first file
+static void bench_formats(const std::string &wav_list, const std::string &model_path)
+{
+    std::vector<timestamp_t> reference;
+    bool first = true;
+    for (const std::string &file : bench::split_list(wav_list)) {
+        wav::MappedWavReader reader(file);
+        if (reader.num_samples() == 0) {
+            std::cout << "file=" << bench::base_name(file) << " unreadable=1" << std::endl;
+            continue;
+        }
+        const int64_t window = static_cast<int64_t>(reader.sample_rate()) / 1000 * 32 * reader.num_channel();
+        const int passes = 10;
+        std::vector<float> block(window);
+        double cpu = cpu_seconds();
+        for (int p = 0; p < passes; p++)
+            for (int64_t offset = 0; offset < reader.num_data(); offset += window)
+                reader.Read(offset, window, block.data());
+        double decode_cpu = cpu_seconds() - cpu;
+
+        auto vad = make_iterator(model_path, reader.sample_rate());
+        {
+            mute_cout mute;
+            vad->process(wav::WavChannelReader(reader));
+        }
+        if (first)
+            reference = vad->get_speech_timestamps();
+        first = false;
+        drift_t drift = timestamp_drift(reference, vad->get_speech_timestamps(), reader.sample_rate());
+        double audio_s = static_cast<double>(reader.num_samples()) / reader.sample_rate();
+        std::cout << "file=" << bench::base_name(file)
+                  << " format=" << reader.format()
+                  << " bits=" << reader.bits_per_sample()
+                  << " channels=" << reader.num_channel()
+                  << " audio_s=" << audio_s
+                  << " decode_us_per_s=" << decode_cpu * 1e6 / (audio_s * passes)
+                  << " speeches=" << vad->get_speech_timestamps().size()
+                  << " reference_speeches=" << reference.size()
+                  << " missed=" << drift.missed
+                  << " mean_drift_ms=" << drift.mean_ms
+                  << " max_drift_ms=" << drift.max_ms
+                  << std::endl;
+    }
+}
+
+#if defined ONNX
+static const char *const backend_name = "onnx";
+#elif defined NATIVE
+static const char *const backend_name = "native";
+#else
+static const char *const backend_name = "nncase";
+#endif
+
+// One suite entry: audio pushed a window at a time into a fresh iterator, over
+// and over until at least min_seconds went through, every push timed
+// Float probability of every window as this backend infers it, written as
+// raw float32 to out_path. Given the dump of another backend (e.g. the onnx
+// runtime build) as reference, prints how far the two are apart.
+static int bench_probs(const wav::WavChannelReader &reader, const std::string &model_path,
+    const std::string &out_path, const std::string &reference_path)
+{
+    auto vad = make_iterator(model_path, reader.sample_rate());
+    const int64_t window = vad->window_samples();
+    std::vector<float> samples(window), probs;
+    for (int64_t offset = 0; offset + window <= reader.num_samples(); offset += window) {
+        reader.Read(offset, window, samples.data());
+        vad->push(samples.data(), samples.size());
+        probs.push_back(vad->last_probability());
+    }
+    std::ofstream out(out_path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(probs.data()), probs.size() * sizeof(float));
+    std::cout << "backend=" << backend_name << " windows=" << probs.size() << " out=" << out_path;
+    if (reference_path.empty()) {
+        std::cout << std::endl;
+        return 0;
+    }
+
+    std::ifstream in(reference_path, std::ios::binary);
+    std::vector<float> reference(probs.size());
+    in.read(reinterpret_cast<char *>(reference.data()), reference.size() * sizeof(float));
+    if (in.gcount() != static_cast<std::streamsize>(reference.size() * sizeof(float)) || in.peek() != EOF) {
+        std::cout << std::endl;
+        std::cerr << reference_path << " does not hold " << probs.size() << " windows" << std::endl;
+        return 1;
+    }
+    double max_err = 0, sum_err = 0;
+    int64_t max_at = 0, flips = 0;
+    for (size_t i = 0; i < probs.size(); i++) {
+        double err = std::abs(static_cast<double>(probs[i]) - reference[i]);
+        sum_err += err;
+        if (err > max_err) {
+            max_err = err;
+            max_at = static_cast<int64_t>(i);
+        }
+        flips += (probs[i] >= 0.5f) != (reference[i] >= 0.5f);
+    }
+    std::cout << " reference=" << reference_path
+              << " max_abs_err=" << max_err << " at_window=" << max_at
+              << " mean_abs_err=" << sum_err / std::max<size_t>(probs.size(), 1)
+              << " threshold_flips=" << flips << std::endl;
+    return 0;
+}
+
+static bench::suite_result_t bench_suite_run(const std::string &model_path, int sample_rate,
+    const std::string &input, const std::vector<float> &audio, double min_seconds)
+{
+    bench::suite_result_t result;
+    result.backend = backend_name;
+    result.model = bench::base_name(model_path);
+    result.sample_rate = sample_rate;
+    result.input = input;
+    try {
+        auto vad = make_iterator(model_path, sample_rate);
+        const size_t window = static_cast<size_t>(vad->window_samples());
+        const size_t windows = audio.size() / window;
+        if (windows == 0)
+            throw std::invalid_argument("audio shorter than a window");
+        result.window_samples = window;
+
+        // Warm-up, so lazy allocations of the runtime are not counted
+        for (size_t w = 0; w < std::min<size_t>(windows, 32); w++)
+            vad->push(&audio[w * window], window);
+        vad->reset();
+
+        const size_t rounds = std::max<size_t>(1, static_cast<size_t>(std::ceil(min_seconds * sample_rate / (windows * window))));
+        result.per_window_us.reserve(rounds * windows);
+        uint64_t allocs = bench::alloc_count.load();
+        uint64_t bytes = bench::alloc_bytes.load();
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t w = 0; w < windows; w++) {
+                auto start = std::chrono::steady_clock::now();
+                vad->push(&audio[w * window], window);
+                result.per_window_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        // The latency vector was reserved up front, so it does not count here
+        result.allocs = bench::alloc_count.load() - allocs;
+        result.alloc_bytes = bench::alloc_bytes.load() - bytes;
+        vad->flush();
+        result.audio_s = static_cast<double>(rounds * windows * window) / sample_rate;
+        result.speeches = static_cast<int64_t>(vad->get_speech_timestamps().size());
+    }
+    catch (const std::invalid_argument &e) {
+        result.skipped = e.what();
+    }
+    catch (const std::exception &e) {
+        result.error = e.what();
+    }
+    return result;
+}
+
+// Every model at 8 and 16 kHz on synthetic audio and on each wav file of that
+// rate, one JSON line per run on stdout
+static int bench_suite(const std::string &wav_list, const std::string &model_list, double min_seconds)
+{
+    struct wav_input_t
+    {
+        std::string name;
+        int sample_rate;
+        std::vector<float> audio;
+    };
+    std::vector<wav_input_t> wavs;
+    for (const std::string &file : bench::split_list(wav_list)) {
+        if (file == "synthetic")
+            continue;
+        wav::MappedWavReader wav_file(file);
+        wav::WavChannelReader reader(wav_file);
+        wavs.push_back({bench::base_name(file), reader.sample_rate(), std::vector<float>(reader.num_samples())});
+        reader.Read(0, wavs.back().audio.size(), wavs.back().audio.data());
+    }
+
+    int failed = 0;
+    for (const std::string &model : bench::split_list(model_list)) {
+        for (int sample_rate : {8000, 16000}) {
+            std::vector<bench::suite_result_t> results;
+            results.push_back(bench_suite_run(model, sample_rate, "synthetic", bench::synthetic_audio(sample_rate, 30), min_seconds));
+            for (const wav_input_t &wav : wavs) {
+                if (wav.sample_rate == sample_rate)
+                    results.push_back(bench_suite_run(model, sample_rate, wav.name, wav.audio, min_seconds));
+            }
+            for (const bench::suite_result_t &result : results) {
+                failed += !result.error.empty();
+                std::cout << bench::format(result) << std::endl;
+            }
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " threads wav_file onnx_file [session|global] [intra_threads] [spin 0|1] [cpu,...]" << std::endl;
+    std::cerr << "       " << name << " track wav_file model_file [track_file]" << std::endl;
+    std::cerr << "       " << name << " shards wav_file model_file [shards] [warmup_ms] [threads]" << std::endl;
+    std::cerr << "       " << name << " ring wav_file model_file [chunk_ms] [speed] [seconds]" << std::endl;
+    std::cerr << "       " << name << " timebatch wav_file model_file [rows] [warmup_ms]" << std::endl;
+    std::cerr << "       " << name << " stages wav_file model_file [json|text]" << std::endl;
+    std::cerr << "       " << name << " suite wav_file,...|synthetic model_file,... [min_seconds]" << std::endl;
+    std::cerr << "       " << name << " gate wav_file,... model_file [floor_db]" << std::endl;
+    std::cerr << "       " << name << " rate wav_file,... model_file [stride] [idle_windows]" << std::endl;
+    std::cerr << "       " << name << " resample wav_file model_file [input_rate,...]" << std::endl;
+    std::cerr << "       " << name << " channels wav_file model_file [rows]" << std::endl;
+    std::cerr << "       " << name << " formats wav_file,... model_file" << std::endl;
+    std::cerr << "       " << name << " probs wav_file model_file out.f32 [reference.f32]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string mode(argv[1]);
+    if (mode == "suite")
+        return bench_suite(argv[2], argv[3], argc > 4 ? std::stod(argv[4]) : 60.0);
+    if (mode == "gate") {
+        bench_gate(argv[2], argv[3], argc > 4 ? std::stof(argv[4]) : -60.0f);
+        return 0;
+    }
+    if (mode == "rate") {
+        bench_rate(argv[2], argv[3], argc > 4 ? std::stoi(argv[4]) : 4, argc > 5 ? std::stoi(argv[5]) : 100);
+        return 0;
+    }
+
+    if (mode == "formats") {
+        bench_formats(argv[2], argv[3]);
+        return 0;
+    }
+    if (mode == "channels") {
+        bench_channels(argv[2], argv[3], argc > 4 ? std::stoi(argv[4]) : 8);
+        return 0;
+    }
+
+    // Multichannel files are downmixed, the modes below all run on one channel
+    wav::MappedWavReader wav_file(argv[2]);
+    wav::WavChannelReader wav_reader(wav_file);
+    std::vector<float> input_wav(wav_reader.num_samples());
+    wav_reader.Read(0, input_wav.size(), input_wav.data());
+    std::string path(argv[3]);
+
+    if (mode == "threads") {
+#if defined ONNX
+        OnnxThreadingPolicy policy;
+        if (argc > 4)
+            policy.global_pools = std::string(argv[4]) == "global";
+        if (argc > 5)
+            policy.intra_threads = std::stoi(argv[5]);
+        if (argc > 6)
+            policy.allow_spinning = std::stoi(argv[6]) != 0;
+        if (argc > 7) {
+            std::string cpus(argv[7]);
+            for (size_t pos = 0; pos < cpus.size();) {
+                size_t next = cpus.find(',', pos);
+                policy.cpu_affinity.push_back(std::stoi(cpus.substr(pos, next - pos)));
+                pos = next == std::string::npos ? cpus.size() : next + 1;
+            }
+        }
+        for (int num_streams : {1, 8, 64})
+            bench_threads(input_wav, wav_reader.sample_rate(), path, policy, num_streams);
+#else
+        std::cerr << "threads benchmark needs the onnx runtime build" << std::endl;
+        return 1;
+#endif
+        return 0;
+    }
+
+    if (mode == "shards") {
+        bench_shards(wav_reader, path, argc > 4 ? std::stoi(argv[4]) : 8,
+            argc > 5 ? std::stoi(argv[5]) : 1000, argc > 6 ? std::stoi(argv[6]) : 0);
+        return 0;
+    }
+
+    if (mode == "ring") {
+        bench_ring(wav_reader, input_wav, path, argc > 4 ? std::stoi(argv[4]) : 10,
+            argc > 5 ? std::stod(argv[5]) : 1.0, argc > 6 ? std::stod(argv[6]) : 10.0);
+        return 0;
+    }
+
+    if (mode == "timebatch") {
+        bench_timebatch(wav_reader, path, argc > 4 ? std::stoi(argv[4]) : 8, argc > 5 ? std::stoi(argv[5]) : 1000);
+        return 0;
+    }
+
+    if (mode == "stages")
+        return bench_stages(wav_reader, path, argc > 4 ? argv[4] : "json");
+
+    if (mode == "resample") {
+        for (const std::string &rate : bench::split_list(argc > 4 ? argv[4] : "48000,44100"))
+            bench_resample(wav_reader, input_wav, path, std::stoi(rate));
+        return 0;
+    }
+
+    if (mode == "probs") {
+        if (argc < 5) {
+            usage(argv[0]);
+            return 1;
+        }
+        return bench_probs(wav_reader, path, argv[4], argc > 5 ? argv[5] : "");
+    }
+
+    if (mode == "track") {
+        bench_track(wav_reader, path, argc > 4 ? argv[4] : "vad_track.bin");
+        return 0;
+    }
+
+    usage(argv[0]);
+    return 1;
+}
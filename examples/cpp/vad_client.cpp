@@ -0,0 +1,191 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "wav.h"
+#include "vad_protocol.h"
+
+using namespace vad_protocol;
+
+// One replayed stream
+struct stream_t
+{
+    int fd = -1;
+    std::vector<char> in;
+    int64_t starts = 0;
+    int64_t ends = 0;
+    bool done = false;
+    std::string error;
+};
+
+static bool send_all(int fd, const std::vector<char> &data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Reads whatever is there and records the events; latency of an event is from
+// sending the chunk that completed the window it was decided on. The server
+// closes right after its done or error frame, so the connection only counts
+// as closed early once the frames read with the end of file are parsed.
+static void receive(stream_t &stream, const std::vector<double> &sent_at, size_t chunk, double now,
+    std::vector<double> &latencies)
+{
+    char buf[16 * 1024];
+    bool closed = false;
+    for (;;) {
+        ssize_t n = recv(stream.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        closed = n == 0;
+        if (n <= 0)
+            break;
+        stream.in.insert(stream.in.end(), buf, buf + n);
+    }
+
+    size_t used = 0;
+    frame_header_t header;
+    const char *payload;
+    while (size_t size = next_frame(stream.in.data() + used, stream.in.size() - used, header, payload)) {
+        used += size;
+        if (header.type == frame_event && header.length == sizeof(event_payload_t)) {
+            event_payload_t event;
+            std::memcpy(&event, payload, sizeof(event));
+            (event.type == 0 ? stream.starts : stream.ends)++;
+            size_t index = event.decided > 0 ? static_cast<size_t>((event.decided - 1) / chunk) : 0;
+            if (index < sent_at.size() && sent_at[index] > 0)
+                latencies.push_back(now - sent_at[index]);
+        }
+        else if (header.type == frame_done)
+            stream.done = true;
+        else if (header.type == frame_error) {
+            stream.error.assign(payload, header.length);
+            stream.done = true;
+        }
+    }
+    stream.in.erase(stream.in.begin(), stream.in.begin() + used);
+
+    if (closed && !stream.done) {
+        stream.done = true;
+        stream.error = "connection closed";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 6) {
+        std::cerr << "Usage: " << argv[0] << " socket_path wav_file streams [chunk_ms] [speed]" << std::endl;
+        std::cerr << "       replays wav_file as int16 on every stream at speed x real time" << std::endl;
+        return 1;
+    }
+    int num_streams = std::stoi(argv[3]);
+    int chunk_ms = argc > 4 ? std::stoi(argv[4]) : 20;
+    double speed = argc > 5 ? std::stod(argv[5]) : 1.0;
+
+    wav::MappedWavReader wav_file(argv[2]);
+    wav::WavChannelReader reader(wav_file);  // multichannel files are downmixed
+    std::vector<float> samples(reader.num_samples());
+    reader.Read(0, samples.size(), samples.data());
+    std::vector<int16_t> pcm(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, samples[i] * 32768)));
+    const size_t chunk = static_cast<size_t>(reader.sample_rate()) * chunk_ms / 1000;
+    const size_t chunks = (pcm.size() + chunk - 1) / chunk;
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+    std::vector<stream_t> streams(num_streams);
+    std::vector<char> frame;
+    for (stream_t &stream : streams) {
+        stream.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(stream.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "cannot connect to " << argv[1] << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        open_payload_t open = { static_cast<uint32_t>(reader.sample_rate()), format_s16 };
+        frame.clear();
+        append_frame(frame, frame_open, &open, sizeof(open));
+        send_all(stream.fd, frame);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto now = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    std::vector<double> sent_at(chunks, 0.0);
+    std::vector<double> latencies;
+    int64_t late = 0; // chunks sent more than one chunk period behind schedule
+    const double period = chunk_ms / 1000.0 / speed;
+    for (size_t c = 0; c < chunks; c++) {
+        std::this_thread::sleep_until(start + std::chrono::duration<double>(c * period));
+        if (now() - c * period > period)
+            late++;
+        size_t count = std::min(chunk, pcm.size() - c * chunk);
+        frame.clear();
+        append_frame(frame, frame_audio, &pcm[c * chunk], static_cast<uint32_t>(count * sizeof(int16_t)));
+        sent_at[c] = now();
+        for (stream_t &stream : streams) {
+            if (!stream.done && !send_all(stream.fd, frame))
+                stream.done = true;
+        }
+        for (stream_t &stream : streams)
+            receive(stream, sent_at, chunk, now(), latencies);
+    }
+
+    frame.clear();
+    append_frame(frame, frame_end, nullptr, 0);
+    for (stream_t &stream : streams) {
+        if (!stream.done)
+            send_all(stream.fd, frame);
+    }
+    std::vector<pollfd> fds(streams.size());
+    for (;;) {
+        size_t waiting = 0;
+        for (size_t i = 0; i < streams.size(); i++) {
+            fds[i] = { streams[i].done ? -1 : streams[i].fd, POLLIN, 0 };
+            waiting += !streams[i].done;
+        }
+        if (waiting == 0 || poll(fds.data(), fds.size(), 10000) <= 0)
+            break;
+        for (size_t i = 0; i < streams.size(); i++) {
+            if (fds[i].revents)
+                receive(streams[i], sent_at, chunk, now(), latencies);
+        }
+    }
+    double wall = now();
+
+    int64_t failed = 0, events = 0;
+    for (stream_t &stream : streams) {
+        if (!stream.error.empty() || !stream.done) {
+            if (failed++ == 0)
+                std::cerr << "stream error: " << (stream.error.empty() ? "no answer" : stream.error) << std::endl;
+        }
+        events += stream.starts + stream.ends;
+        close(stream.fd);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) { return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(q * (latencies.size() - 1))] * 1e3; };
+    std::cout << "streams=" << num_streams
+              << " failed=" << failed
+              << " audio_s_per_stream=" << static_cast<double>(pcm.size()) / reader.sample_rate()
+              << " wall_s=" << wall
+              << " late_chunks=" << late
+              << " speeches_stream0=" << streams[0].ends
+              << " events=" << events
+              << " p50_ms=" << at(0.5) << " p99_ms=" << at(0.99) << " max_ms=" << at(1.0)
+              << std::endl;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,1398 @@
+#ifndef SILERO_VAD_ITERATOR_H_
+#define SILERO_VAD_ITERATOR_H_
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+#include <cinttypes>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+#include "prob_track.h"
+#include "stage_timers.h"
+#include "energy_gate.h"
+#include "adaptive_rate.h"
+#include "resampler.h"
+
+#if defined(ONNX)
+#include <atomic>
+#include <thread>
+#include <pthread.h>
+#include "onnxruntime_cxx_api.h"
+#include "onnxruntime_session_options_config_keys.h"
+#elif !defined(NATIVE)
+#include <nncase/runtime/interpreter.h>
+#include <nncase/runtime/runtime_tensor.h>
+#include <nncase/runtime/simple_types.h>
+#include <nncase/runtime/util.h>
+#include <nncase/runtime/runtime_op_utility.h>
+#endif
+
+//#define __DEBUG_SPEECH_PROB___
+
+class timestamp_t
+{
+public:
+    int64_t start;
+    int64_t end;
+
+    // default + parameterized constructor
+    timestamp_t(int64_t start = -1, int64_t end = -1)
+        : start(start), end(end)
+    {
+    };
+
+    // assignment operator modifies object, therefore non-const
+    timestamp_t& operator=(const timestamp_t& a)
+    {
+        start = a.start;
+        end = a.end;
+        return *this;
+    };
+
+    // equality comparison. doesn't modify object. therefore const.
+    bool operator==(const timestamp_t& a) const
+    {
+        return (start == a.start && end == a.end);
+    };
+    std::string c_str()
+    {
+        //return std::format("timestamp {:08d}, {:08d}", start, end);
+        return format("{start:%08" PRId64 ",end:%08" PRId64 "}", start, end);
+    };
+private:
+
+    std::string format(const char* fmt, ...)
+    {
+        char buf[256];
+
+        va_list args;
+        va_start(args, fmt);
+        const auto r = std::vsnprintf(buf, sizeof buf, fmt, args);
+        va_end(args);
+
+        if (r < 0)
+            // conversion failed
+            return {};
+
+        const size_t len = r;
+        if (len < sizeof buf)
+            // we fit in the buffer
+            return { buf, len };
+
+#if __cplusplus >= 201703L
+        // C++17: Create a string and write to its underlying array
+        std::string s(len, '\0');
+        va_start(args, fmt);
+        std::vsnprintf(s.data(), len + 1, fmt, args);
+        va_end(args);
+
+        return s;
+#else
+        // C++11 or C++14: We need to allocate scratch memory
+        auto vbuf = std::unique_ptr<char[]>(new char[len + 1]);
+        va_start(args, fmt);
+        std::vsnprintf(vbuf.get(), len + 1, fmt, args);
+        va_end(args);
+
+        return { vbuf.get(), len };
+#endif
+    };
+};
+
+// A speech boundary, reported by VadIterator::push as soon as it is decided
+struct vad_event_t
+{
+    enum type_t { speech_start, speech_end };
+    type_t type;
+    int64_t sample;  // position since the last reset
+};
+
+class VadIterator
+{
+private:
+    // Infer the [context | window] in input_buffer() and segment its probability
+    virtual void predict() {}
+
+protected:
+    friend class BatchedVadEngine;
+
+    // Segmentation state machine, fed with the probability of every window
+    void segment(float speech_prob)
+    {
+        VAD_STAGE(stage_timers, stage_segment);
+        if (track)
+            track->push(speech_prob);
+        last_prob = speech_prob;
+
+        // Push forward sample index
+        current_sample += window_size_samples;
+
+        // Reset temp_end when > threshold
+        if ((speech_prob >= threshold))
+        {
+#ifdef __DEBUG_SPEECH_PROB___
+            double speech = current_sample - window_size_samples; // minus window_size_samples to get precise start time point.
+            printf("{    start: %.3f s (%.3f) %08" PRId64 "}\n", 1.0 * speech / sample_rate, speech_prob, current_sample- window_size_samples);
+#endif //__DEBUG_SPEECH_PROB___
+            if (temp_end != 0)
+            {
+                temp_end = 0;
+                if (next_start < prev_end)
+                    next_start = current_sample - window_size_samples;
+            }
+            if (triggered == false)
+            {
+                triggered = true;
+
+                current_speech.start = current_sample - window_size_samples;
+            }
+            return;
+        }
+
+        if (
+            (triggered == true)
+            && ((current_sample - current_speech.start) > max_speech_samples)
+            ) {
+            if (prev_end > 0) {
+                current_speech.end = prev_end;
+                speeches.push_back(current_speech);
+                current_speech = timestamp_t();
+
+                // previously reached silence(< neg_thres) and is still not speech(< thres)
+                if (next_start < prev_end)
+                    triggered = false;
+                else{
+                    current_speech.start = next_start;
+                }
+                prev_end = 0;
+                next_start = 0;
+                temp_end = 0;
+
+            }
+            else{
+                current_speech.end = current_sample;
+                speeches.push_back(current_speech);
+                current_speech = timestamp_t();
+                prev_end = 0;
+                next_start = 0;
+                temp_end = 0;
+                triggered = false;
+            }
+            return;
+
+        }
+        if ((speech_prob >= (threshold - 0.15)) && (speech_prob < threshold))
+        {
+            if (triggered) {
+#ifdef __DEBUG_SPEECH_PROB___
+                double speech = current_sample - window_size_samples; // minus window_size_samples to get precise start time point.
+                printf("{ speeking: %.3f s (%.3f) %08" PRId64 "}\n", 1.0 * speech / sample_rate, speech_prob, current_sample - window_size_samples);
+#endif //__DEBUG_SPEECH_PROB___
+            }
+            else {
+#ifdef __DEBUG_SPEECH_PROB___
+                double speech = current_sample - window_size_samples; // minus window_size_samples to get precise start time point.
+                printf("{  silence: %.3f s (%.3f) %08" PRId64 "}\n", 1.0 * speech / sample_rate, speech_prob, current_sample - window_size_samples);
+#endif //__DEBUG_SPEECH_PROB___
+            }
+            return;
+        }
+
+
+        // 4) End
+        if ((speech_prob < (threshold - 0.15)))
+        {
+#ifdef __DEBUG_SPEECH_PROB___
+            double speech = current_sample - window_size_samples - speech_pad_samples; // minus window_size_samples to get precise start time point.
+            printf("{      end: %.3f s (%.3f) %08" PRId64 "}\n", 1.0 * speech / sample_rate, speech_prob, current_sample - window_size_samples);
+#endif //__DEBUG_SPEECH_PROB___
+            if (triggered == true)
+            {
+                if (temp_end == 0)
+                {
+                    temp_end = current_sample;
+                }
+                if (current_sample - temp_end > min_silence_samples_at_max_speech)
+                    prev_end = temp_end;
+                // a. silence < min_slience_samples, continue speaking
+                if ((current_sample - temp_end) < min_silence_samples)
+                {
+
+                }
+                // b. silence >= min_slience_samples, end speaking
+                else
+                {
+                    current_speech.end = temp_end;
+                    if (current_speech.end - current_speech.start > min_speech_samples)
+                    {
+                        speeches.push_back(current_speech);
+                        current_speech = timestamp_t();
+                        prev_end = 0;
+                        next_start = 0;
+                        temp_end = 0;
+                        triggered = false;
+                    }
+                }
+            }
+            else {
+                // may first windows see end state.
+            }
+            return;
+        }
+    };
+
+    virtual void reset_states()
+    {
+        // Call reset before each audio start
+        std::memset(_state.data(), 0.0f, _state.size() * sizeof(float));
+        triggered = false;
+        temp_end = 0;
+        current_sample = 0;
+
+        prev_end = next_start = 0;
+
+        speeches.clear();
+        current_speech = timestamp_t();
+        pending_samples = 0;
+        std::memset(input_buffer(), 0, context_samples * sizeof(float));
+        if (track)
+            track->clear();
+        gate.reset();
+        rate.reset();
+        if (resampler)
+            resampler->reset();
+        last_prob = 0.0f;
+    };
+
+    // The model input, [context | window] contiguous. Backends bind their input
+    // tensor to it once, audio is written straight into its window part and the
+    // context is carried over in place, so nothing is copied to build a frame.
+    virtual float *input_buffer()
+    {
+        return input.data();
+    };
+
+    float *next_window()
+    {
+        return input_buffer() + context_samples;
+    };
+
+    // Infer the window written at next_window(), its tail becomes the next context
+    void infer_window()
+    {
+        VAD_STAGE(stage_timers, stage_window);
+        if (rate.enabled() && rate.skip())
+            segment(last_prob);
+        else {
+            if (gate.enabled() && gate.skip(next_window(), window_size_samples, last_prob))
+                skip_window();
+            else
+                predict();
+            if (rate.enabled())
+                rate.observe(last_prob, threshold - 0.15f);
+        }
+        VAD_STAGE(stage_timers, stage_state);
+        float *buffer = input_buffer();
+        std::memcpy(buffer, buffer + window_size_samples, context_samples * sizeof(float));
+    };
+
+    // A window the energy gate kept from the model: the state follows the gate
+    // policy and the segmentation sees its fixed probability
+    void skip_window()
+    {
+        if (gate.policy().state == gate_state_t::decay)
+            scale_state(gate.policy().decay);
+        segment(gate.policy().skipped_prob);
+    };
+
+    // Multiply the lstm state the next window will read by factor
+    virtual void scale_state(float factor)
+    {
+        for (float &value : _state)
+            value *= factor;
+    };
+
+    // For models exported without the context input (0), before any binding is made
+    void set_context_samples(int samples)
+    {
+        context_samples = samples;
+        input.assign(context_samples + window_size_samples, 0.0f);
+        input_node_dims[1] = context_samples + window_size_samples;
+    };
+
+    // Records into events the boundaries decided since there were `ended`
+    // speeches and the open one started at `started`
+    void add_events(size_t ended, int64_t started)
+    {
+        for (; ended < speeches.size(); ended++)
+            events.push_back({vad_event_t::speech_end, speeches[ended].end});
+        if (current_speech.start >= 0 && current_speech.start != started)
+            events.push_back({vad_event_t::speech_start, current_speech.start});
+    };
+
+    // Infers one window of pushed audio and records the boundaries it decided
+    void infer_pushed_window()
+    {
+        size_t ended = speeches.size();
+        int64_t started = current_speech.start;
+        infer_window();
+        add_events(ended, started);
+    };
+
+    static void to_float(const float *src, float *dst, size_t count)
+    {
+        std::memcpy(dst, src, count * sizeof(float));
+    };
+
+    static void to_float(const int16_t *src, float *dst, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            dst[i] = src[i] * (1.0f / 32768);
+    };
+
+    template <typename T>
+    const std::vector<vad_event_t>& push_samples(const T *data, size_t count)
+    {
+        events.clear();
+        if (!resampler) {
+            feed_samples(data, count);
+            return events;
+        }
+        while (count > 0) {
+            size_t take = std::min(count, resample_block);
+            size_t produced;
+            {
+                VAD_STAGE(stage_timers, stage_input);
+                produced = resampler->process(data, take, resampled.data());
+            }
+            feed_samples(resampled.data(), produced);
+            data += take;
+            count -= take;
+        }
+        return events;
+    };
+
+    // Model rate samples into the pending window, inferring each completed one
+    template <typename T>
+    void feed_samples(const T *data, size_t count)
+    {
+        const size_t window = window_size_samples;
+        while (count > 0) {
+            size_t take = std::min(count, window - pending_samples);
+            {
+                VAD_STAGE(stage_timers, stage_input);
+                to_float(data, next_window() + pending_samples, take);
+            }
+            pending_samples += take;
+            data += take;
+            count -= take;
+            if (pending_samples == window) {
+                infer_pushed_window();
+                pending_samples = 0;
+            }
+        }
+    };
+
+public:
+    void process(const std::vector<float>& input_wav)
+    {
+        reset_states();
+
+        audio_length_samples = input_wav.size();
+        std::cout << "window_size_samples = " << window_size_samples << ", audio_length_samples = " << audio_length_samples << std::endl;
+
+        for (int64_t j = 0; j < audio_length_samples; j += window_size_samples)
+        {
+            if (j + window_size_samples > audio_length_samples)
+                break;
+            {
+                VAD_STAGE(stage_timers, stage_input);
+                std::memcpy(next_window(), &input_wav[0] + j, window_size_samples * sizeof(float));
+            }
+            infer_window();
+        }
+
+        finish(audio_length_samples);
+    };
+
+    // Same as process(input_wav), but windows are converted one at a time by
+    // reader.Read(offset, count, dst) (e.g. wav::MappedWavReader), and what was
+    // read is given back with reader.Release(offset, count) as it goes, so
+    // neither the float audio nor the file itself has to stay resident.
+    template <typename Reader>
+    void process(const Reader& reader)
+    {
+        reset_states();
+
+        audio_length_samples = reader.num_samples();
+        std::cout << "window_size_samples = " << window_size_samples << ", audio_length_samples = " << audio_length_samples << std::endl;
+
+        const int64_t release_samples = int64_t(1) << 16;
+        int64_t released = 0;
+        for (int64_t j = 0; j < audio_length_samples; j += window_size_samples)
+        {
+            if (j + window_size_samples > audio_length_samples)
+                break;
+            {
+                VAD_STAGE(stage_timers, stage_input);
+                reader.Read(j, window_size_samples, next_window());
+            }
+            infer_window();
+            if (j + window_size_samples - released >= release_samples) {
+                reader.Release(released, j + window_size_samples - released);
+                released = j + window_size_samples;
+            }
+        }
+
+        finish(audio_length_samples);
+    };
+
+    // Streaming file mode: audio is read window by window through
+    // reader.Read(offset, count, dst), every block_samples the consumed part is
+    // given back with reader.Release(offset, count), and every speech is handed
+    // to on_speech(const timestamp_t&) as soon as it is closed and then dropped.
+    // Memory stays constant whatever the length of the recording, and
+    // get_speech_timestamps() is left empty.
+    template <typename Reader, typename OnSpeech>
+    void process(const Reader& reader, int64_t block_samples, OnSpeech on_speech)
+    {
+        reset_states();
+
+        audio_length_samples = reader.num_samples();
+        block_samples = std::max<int64_t>(block_samples / window_size_samples, 1) * window_size_samples;
+
+        for (int64_t offset = 0; offset + window_size_samples <= audio_length_samples; offset += block_samples)
+        {
+            int64_t count = std::min(block_samples, audio_length_samples - offset);
+            for (int64_t j = 0; j + window_size_samples <= count; j += window_size_samples) {
+                {
+                    VAD_STAGE(stage_timers, stage_input);
+                    reader.Read(offset + j, window_size_samples, next_window());
+                }
+                infer_window();
+            }
+            reader.Release(offset, count);
+
+            for (const timestamp_t& speech : speeches)
+                on_speech(speech);
+            speeches.clear();
+        }
+
+        finish(audio_length_samples);
+        for (const timestamp_t& speech : speeches)
+            on_speech(speech);
+        speeches.clear();
+    };
+
+    // Live input in chunks of any size (e.g. 20 ms frames). Audio is buffered up
+    // to the model window, each completed window is inferred immediately and the
+    // speech starts/ends it decided are returned. The events stay valid until the
+    // next push, flush or reset.
+    const std::vector<vad_event_t>& push(const float *data, size_t count)
+    {
+        return push_samples(data, count);
+    };
+
+    const std::vector<vad_event_t>& push(const int16_t *data, size_t count)
+    {
+        return push_samples(data, count);
+    };
+
+    // End of the live input: a partial window is dropped as in process(), and a
+    // speech still open ends here.
+    const std::vector<vad_event_t>& flush()
+    {
+        events.clear();
+        if (resampler)
+            feed_samples(resampled.data(), resampler->flush(resampled.data()));
+        size_t ended = speeches.size();
+        finish(current_sample + pending_samples);
+        pending_samples = 0;
+        add_events(ended, current_speech.start);
+        return events;
+    };
+
+    // Live input fed by another thread through a SpscRing of float or int16
+    // samples: whole windows are popped as soon as they are complete (float
+    // straight into the model input), and every event is handed to
+    // on_event(const vad_event_t&) once decided, as with push(). Returns after
+    // the producer has closed the ring and it is drained, with flush() applied.
+    template <typename Ring, typename OnEvent>
+    void consume(Ring &ring, OnEvent on_event)
+    {
+        typedef typename Ring::value_type sample_t;
+        const size_t window = window_size_samples;
+        if (resampler) {
+            // Input rate samples, a model window's worth at a time
+            std::vector<sample_t> staging(window);
+            size_t got;
+            while ((got = ring.pop_wait(staging.data(), window, window)) > 0) {
+                for (const vad_event_t &event : push_samples(staging.data(), got))
+                    on_event(event);
+            }
+            for (const vad_event_t &event : flush())
+                on_event(event);
+            return;
+        }
+        std::vector<sample_t> staging(std::is_same<sample_t, float>::value ? 0 : window_size_samples);
+        for (;;) {
+            size_t want = window - pending_samples;
+            size_t got;
+            if constexpr (std::is_same<sample_t, float>::value)
+                got = ring.pop_wait(next_window() + pending_samples, want, want);
+            else {
+                got = ring.pop_wait(staging.data(), want, want);
+                VAD_STAGE(stage_timers, stage_input);
+                to_float(staging.data(), next_window() + pending_samples, got);
+            }
+            pending_samples += got;
+            if (pending_samples < window) {
+                if (got == 0) // closed and drained
+                    break;
+                continue;
+            }
+
+            events.clear();
+            infer_pushed_window();
+            pending_samples = 0;
+            for (const vad_event_t &event : events)
+                on_event(event);
+        }
+        for (const vad_event_t &event : flush())
+            on_event(event);
+    };
+
+    // Start a new live input
+    void reset()
+    {
+        reset_states();
+        events.clear();
+    };
+
+    // Close a speech still open at the end of the audio
+    void finish(int64_t audio_length)
+    {
+        if (track)
+            track->audio_length_samples = audio_length;
+        if (current_speech.start >= 0) {
+            current_speech.end = audio_length;
+            speeches.push_back(current_speech);
+            current_speech = timestamp_t();
+            prev_end = 0;
+            next_start = 0;
+            temp_end = 0;
+            triggered = false;
+        }
+    };
+
+    // Keep the probability of every window of the next audio in track (nullptr
+    // stops recording). The track is cleared whenever the iterator is reset.
+    void record(ProbTrack *Track)
+    {
+        track = Track;
+        if (track) {
+            track->sample_rate = sample_rate;
+            track->window_size_samples = window_size_samples;
+            track->clear();
+        }
+    };
+
+    // Second stage: timestamps of a recorded track under this iterator's
+    // parameters, no inference. A plain VadIterator(Sample_rate, ...) is enough.
+    void process(const ProbTrack& Track)
+    {
+        if (Track.sample_rate != sample_rate || Track.window_size_samples != window_size_samples)
+            throw std::invalid_argument("probability track was recorded with another sample rate or window");
+
+        ProbTrack *recording = track;
+        track = nullptr;
+        reset_states();
+        audio_length_samples = Track.audio_length_samples;
+        for (size_t i = 0; i < Track.size(); i++)
+            segment(Track.prob(i));
+        finish(audio_length_samples);
+        track = recording;
+    };
+
+    void process(const std::vector<float>& input_wav, std::vector<float>& output_wav)
+    {
+        process(input_wav);
+        collect_chunks(input_wav, output_wav);
+    }
+
+    void collect_chunks(const std::vector<float>& input_wav, std::vector<float>& output_wav)
+    {
+        output_wav.clear();
+        for (int i = 0; i < speeches.size(); i++) {
+#ifdef __DEBUG_SPEECH_PROB___
+            std::cout << speeches[i].c_str() << std::endl;
+#endif //#ifdef __DEBUG_SPEECH_PROB___
+            std::vector<float> slice(&input_wav[speeches[i].start], &input_wav[speeches[i].end]);
+            output_wav.insert(output_wav.end(),slice.begin(),slice.end());
+        }
+    };
+
+    // Same for a file reader, streamed once block by block, so only the
+    // output grows with the file
+    template <typename Reader>
+    void collect_chunks(const Reader &reader, std::vector<float>& output_wav)
+    {
+        std::vector<std::pair<int64_t, int64_t>> ranges;
+        for (const timestamp_t &speech : speeches)
+            ranges.emplace_back(speech.start, speech.end);
+        copy_ranges(reader, ranges, output_wav);
+    };
+
+    const std::vector<timestamp_t> get_speech_timestamps() const
+    {
+        return speeches;
+    }
+
+    // Probability the segmentation saw for the last window, as the model gave it
+    float last_probability() const
+    {
+        return last_prob;
+    };
+
+    // Audio given to push() and consume() is at input rate (e.g. 48000 or
+    // 44100) and resampled to the model rate on the way in; timestamps and
+    // events stay in samples of the model rate. For files, wrap the reader in
+    // a ResampledReader instead.
+    void set_input_rate(int rate)
+    {
+        if (rate == sample_rate)
+            resampler.reset();
+        else {
+            resampler.emplace(rate, sample_rate);
+            resampled.resize(resampler->max_output(resample_block));
+        }
+    };
+
+    int input_rate() const
+    {
+        return resampler ? resampler->input_rate() : sample_rate;
+    };
+
+    // Skip the model on windows of silence or faint noise, see EnergyGatePolicy.
+    // Off by default; set before the audio starts.
+    void set_energy_gate(const EnergyGatePolicy &policy)
+    {
+        gate.set_policy(policy);
+    };
+
+    void disable_energy_gate()
+    {
+        gate.disable();
+    };
+
+    // Windows seen and skipped since the gate was set
+    const gate_stats_t &get_gate_stats() const
+    {
+        return gate.get_stats();
+    };
+
+    // Infer only every k-th window over sustained non-speech, see
+    // AdaptiveRatePolicy. Off by default.
+    void set_adaptive_rate(const AdaptiveRatePolicy &policy)
+    {
+        rate.set_policy(policy);
+    };
+
+    void disable_adaptive_rate()
+    {
+        rate.disable();
+    };
+
+    // Windows seen and skipped, returns to full rate and the stride now
+    const rate_stats_t &get_rate_stats() const
+    {
+        return rate.get_stats();
+    };
+
+#if defined VAD_STAGE_TIMERS
+    // Latency of each stage over every window since construction or clear
+    const StageTimers& get_stage_timers() const
+    {
+        return stage_timers;
+    };
+
+    StageTimers& get_stage_timers()
+    {
+        return stage_timers;
+    };
+#endif
+
+    int64_t window_samples() const
+    {
+        return window_size_samples;
+    };
+
+    void drop_chunks(const std::vector<float>& input_wav, std::vector<float>& output_wav)
+    {
+        output_wav.clear();
+        int64_t current_start = 0;
+        for (int i = 0; i < speeches.size(); i++) {
+
+            std::vector<float> slice(&input_wav[current_start],&input_wav[speeches[i].start]);
+            output_wav.insert(output_wav.end(), slice.begin(), slice.end());
+            current_start = speeches[i].end;
+        }
+
+        std::vector<float> slice(&input_wav[current_start], &input_wav[input_wav.size()]);
+        output_wav.insert(output_wav.end(), slice.begin(), slice.end());
+    };
+
+    template <typename Reader>
+    void drop_chunks(const Reader &reader, std::vector<float>& output_wav)
+    {
+        std::vector<std::pair<int64_t, int64_t>> ranges;
+        int64_t current_start = 0;
+        for (const timestamp_t &speech : speeches) {
+            ranges.emplace_back(current_start, speech.start);
+            current_start = speech.end;
+        }
+        ranges.emplace_back(current_start, reader.num_samples());
+        copy_ranges(reader, ranges, output_wav);
+    };
+
+private:
+    // Appends samples [first, second) of each of the ordered ranges, reading
+    // the file sequentially and releasing it behind
+    template <typename Reader>
+    static void copy_ranges(const Reader &reader, const std::vector<std::pair<int64_t, int64_t>> &ranges,
+        std::vector<float>& output_wav)
+    {
+        const int64_t block = 1 << 16;
+        const int64_t length = reader.num_samples();
+        std::vector<float> buffer(block);
+        int64_t total = 0;
+        for (const auto &range : ranges)
+            total += std::max<int64_t>(0, std::min(range.second, length) - range.first);
+        output_wav.clear();
+        output_wav.reserve(total);
+        size_t r = 0;
+        for (int64_t offset = 0; offset < length && r < ranges.size(); offset += block) {
+            int64_t end = offset + reader.Read(offset, std::min(block, length - offset), buffer.data());
+            for (; r < ranges.size() && ranges[r].first < end; r++) {
+                int64_t from = std::max(ranges[r].first, offset);
+                int64_t to = std::min(ranges[r].second, end);
+                if (to > from)
+                    output_wav.insert(output_wav.end(), buffer.begin() + (from - offset), buffer.begin() + (to - offset));
+                if (ranges[r].second > end)
+                    break;
+            }
+            reader.Release(offset, end - offset);
+        }
+    };
+
+protected:
+    // model config
+    int64_t window_size_samples;  // Assign when init, support 256 512 768 for 8k; 512 1024 1536 for 16k.
+    int context_samples;  // Tail of the previous window fed before each window, 64 for 16k; 32 for 8k.
+    int sample_rate;  //Assign when init support 16000 or 8000
+    int sr_per_ms;   // Assign when init, support 8 or 16
+    float threshold;
+    int min_silence_samples; // sr_per_ms * #ms
+    int min_silence_samples_at_max_speech; // sr_per_ms * #98
+    int min_speech_samples; // sr_per_ms * #ms
+    double max_speech_samples;
+    int speech_pad_samples; // usually a
+    int64_t audio_length_samples;
+
+    // model states, 64-bit so recordings of any length keep exact sample positions
+    bool triggered = false;
+    int64_t temp_end = 0;
+    int64_t current_sample = 0;
+    int64_t prev_end = 0;
+    int64_t next_start = 0;
+
+    //Output timestamp
+    std::vector<timestamp_t> speeches;
+    timestamp_t current_speech;
+    ProbTrack *track = nullptr; // see record()
+
+    // samples of a push() window already in next_window(), and the events of the last call
+    size_t pending_samples = 0;
+    std::vector<vad_event_t> events;
+    EnergyGate gate;
+    AdaptiveRate rate;
+    std::optional<PolyphaseResampler> resampler; // see set_input_rate()
+    std::vector<float> resampled;
+    static constexpr size_t resample_block = 4096;
+    float last_prob = 0.0f; // segmented last, for the gate and the adaptive rate
+
+#if defined VAD_STAGE_TIMERS
+    StageTimers stage_timers;
+#endif
+
+    std::vector<const char *> input_node_names = {"input", "state", "sr"};
+    std::vector<float> input;  // [context | window]
+    unsigned int size_state = 2 * 1 * 128; // It's FIXED.
+    std::vector<float> _state;
+    std::vector<int64_t> sr;
+
+    int64_t input_node_dims[2] = {};
+    const int64_t state_node_dims[3] = {2, 1, 128};
+    const int64_t sr_node_dims[1] = {1};
+
+    // Outputs
+    std::vector<const char *> output_node_names = {"output", "stateN"};
+
+public:
+    // Construction
+    VadIterator(int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity())
+    {
+        if (Sample_rate != 8000 && Sample_rate != 16000)
+            throw std::invalid_argument("the model runs at 8000 or 16000 Hz, not " + std::to_string(Sample_rate)
+                + "; resample other rates with set_input_rate() or ResampledReader");
+        threshold = Threshold;
+        sample_rate = Sample_rate;
+        sr_per_ms = sample_rate / 1000;
+
+        window_size_samples = windows_frame_size * sr_per_ms;
+        context_samples = sample_rate == 16000 ? 64 : 32;
+
+        min_speech_samples = sr_per_ms * min_speech_duration_ms;
+        speech_pad_samples = sr_per_ms * speech_pad_ms;
+
+        max_speech_samples = (
+            static_cast<double>(sample_rate) * max_speech_duration_s
+            - window_size_samples
+            - 2 * speech_pad_samples
+            );
+
+        min_silence_samples = sr_per_ms * min_silence_duration_ms;
+        min_silence_samples_at_max_speech = sr_per_ms * 98;
+
+        input.resize(context_samples + window_size_samples);
+        events.reserve(8);
+        input_node_dims[0] = 1;
+        input_node_dims[1] = context_samples + window_size_samples;
+
+        _state.resize(size_state);
+        sr.resize(1);
+        sr[0] = sample_rate;
+    };
+
+    virtual ~VadIterator() = default;
+};
+
+#if defined ONNX
+
+// How the ORT threads of an OnnxVadModel are set up. Per-session pools give every
+// model its own intra/inter pools; global pools are created once per process by
+// the first model that asks for them and shared by all later ones (their pool
+// settings are then ignored), which avoids oversubscription with many sessions.
+struct OnnxThreadingPolicy
+{
+    bool global_pools = false;
+    int intra_threads = 1;
+    int inter_threads = 1;
+    bool allow_spinning = true;   // busy-wait for work instead of sleeping
+    std::vector<int> cpu_affinity; // pool threads are pinned round-robin to these cpus, empty = no pinning
+};
+
+// Creates ORT pool threads pinned to a list of cpus
+class OnnxThreadPinner
+{
+public:
+    static OrtCustomThreadHandle create_thread(void *options, OrtThreadWorkerFn worker, void *param)
+    {
+        auto *pinner = static_cast<OnnxThreadPinner *>(options);
+        auto *thread = new std::thread(worker, param);
+        int cpu = pinner->cpus[pinner->next++ % pinner->cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread->native_handle(), sizeof(set), &set);
+        return reinterpret_cast<OrtCustomThreadHandle>(thread);
+    };
+
+    static void join_thread(OrtCustomThreadHandle handle)
+    {
+        auto *thread = reinterpret_cast<std::thread *>(const_cast<OrtCustomHandleType *>(handle));
+        thread->join();
+        delete thread;
+    };
+
+    explicit OnnxThreadPinner(const std::vector<int> &Cpus) : cpus(Cpus) {}
+
+private:
+    std::vector<int> cpus;
+    std::atomic<size_t> next{0};
+};
+
+// The loaded model, shared read-only by any number of iterators. Per stream
+// objects only keep their buffers and bindings. Session::Run is thread safe,
+// so iterators on different threads may share one model.
+class OnnxVadModel
+{
+private:
+    // OnnxRuntime resources
+    std::unique_ptr<OnnxThreadPinner> pinner; // must outlive the session pools
+    Ort::Env own_env{nullptr};
+    Ort::Env *env = nullptr;
+    Ort::SessionOptions session_options;
+    std::unique_ptr<Ort::Session> session_;
+    bool takes_sr = true;
+
+    static Ort::Env create_global_env(const OnnxThreadingPolicy &policy, OnnxThreadPinner *global_pinner)
+    {
+        const OrtApi &api = Ort::GetApi();
+        OrtThreadingOptions *options = nullptr;
+        Ort::ThrowOnError(api.CreateThreadingOptions(&options));
+        Ort::ThrowOnError(api.SetGlobalIntraOpNumThreads(options, policy.intra_threads));
+        Ort::ThrowOnError(api.SetGlobalInterOpNumThreads(options, policy.inter_threads));
+        Ort::ThrowOnError(api.SetGlobalSpinControl(options, policy.allow_spinning ? 1 : 0));
+        if (global_pinner) {
+            Ort::ThrowOnError(api.SetGlobalCustomCreateThreadFn(options, OnnxThreadPinner::create_thread));
+            Ort::ThrowOnError(api.SetGlobalCustomThreadCreationOptions(options, global_pinner));
+            Ort::ThrowOnError(api.SetGlobalCustomJoinThreadFn(options, OnnxThreadPinner::join_thread));
+        }
+        Ort::Env global_env(options);
+        api.ReleaseThreadingOptions(options);
+        return global_env;
+    };
+
+    // The process wide env owning the global pools, created on first use
+    static Ort::Env &global_env(const OnnxThreadingPolicy &policy)
+    {
+        static std::unique_ptr<OnnxThreadPinner> global_pinner(
+            policy.cpu_affinity.empty() ? nullptr : new OnnxThreadPinner(policy.cpu_affinity));
+        static Ort::Env global_env = create_global_env(policy, global_pinner.get());
+        return global_env;
+    };
+
+    void init_engine_threads(int inter_threads, int intra_threads)
+    {
+        // The method should be called in each thread/proc in multi-thread/proc work
+        session_options.SetIntraOpNumThreads(intra_threads);
+        session_options.SetInterOpNumThreads(inter_threads);
+        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        if (inter_threads > 1)
+            session_options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+    };
+
+    void init_threading(const OnnxThreadingPolicy &policy)
+    {
+        init_engine_threads(policy.inter_threads, policy.intra_threads);
+        if (policy.global_pools) {
+            env = &global_env(policy);
+            session_options.DisablePerSessionThreads();
+            return;
+        }
+
+        own_env = Ort::Env();
+        env = &own_env;
+        if (!policy.allow_spinning) {
+            session_options.AddConfigEntry(kOrtSessionOptionsConfigAllowIntraOpSpinning, "0");
+            session_options.AddConfigEntry(kOrtSessionOptionsConfigAllowInterOpSpinning, "0");
+        }
+        if (!policy.cpu_affinity.empty()) {
+            pinner.reset(new OnnxThreadPinner(policy.cpu_affinity));
+            session_options.SetCustomCreateThreadFn(OnnxThreadPinner::create_thread);
+            session_options.SetCustomThreadCreationOptions(pinner.get());
+            session_options.SetCustomJoinThreadFn(OnnxThreadPinner::join_thread);
+        }
+    };
+
+public:
+    Ort::Session &session() const
+    {
+        return *session_;
+    };
+
+    // False for exports with the rate fixed at 16 kHz and no sr input (silero_vad_half.onnx)
+    bool takes_sample_rate() const
+    {
+        return takes_sr;
+    };
+
+    // Throws unless the model can run at sample_rate
+    void check_sample_rate(int sample_rate) const
+    {
+        if (!takes_sr && sample_rate != 16000)
+            throw std::invalid_argument("model has no sr input, it only runs at 16000 Hz");
+    };
+
+    // Construction
+    OnnxVadModel(const std::string& model_path, const OnnxThreadingPolicy &policy = OnnxThreadingPolicy())
+    {
+        init_threading(policy);
+        // Load model
+        session_ = std::make_unique<Ort::Session>(*env, model_path.c_str(), session_options);
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        takes_sr = false;
+        for (size_t i = 0; i < session_->GetInputCount(); i++)
+            takes_sr = takes_sr || std::strcmp(session_->GetInputNameAllocated(i, allocator).get(), "sr") == 0;
+    }
+};
+
+class OnnxVadIterator: public VadIterator
+{
+private:
+    std::shared_ptr<OnnxVadModel> model;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeCPU);
+
+private:
+    void init_model(const std::string& model_path, const OnnxThreadingPolicy &policy)
+    {
+        model = std::make_shared<OnnxVadModel>(model_path, policy);
+        init_binding();
+    };
+
+    void init_binding()
+    {
+        // Wrap the persistent buffers once. Binding i feeds state buffer i and
+        // receives stateN into the other one, so predict() just alternates them.
+        model->check_sample_rate(sample_rate);
+        _stateN.resize(size_state);
+        output.resize(input_node_dims[0]);
+        float *state_bufs[2] = { _state.data(), _stateN.data() };
+
+        input_ort = Ort::Value::CreateTensor<float>(
+            memory_info, input.data(), input.size(), input_node_dims, 2);
+        sr_ort = Ort::Value::CreateTensor<int64_t>(
+            memory_info, sr.data(), sr.size(), sr_node_dims, 1);
+        output_ort = Ort::Value::CreateTensor<float>(
+            memory_info, output.data(), output.size(), output_node_dims, 2);
+        for (int i = 0; i < 2; i++)
+        {
+            state_ort[i] = Ort::Value::CreateTensor<float>(
+                memory_info, state_bufs[i], size_state, state_node_dims, 3);
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            io_binding[i] = std::make_unique<Ort::IoBinding>(model->session());
+            io_binding[i]->BindInput(input_node_names[0], input_ort);
+            io_binding[i]->BindInput(input_node_names[1], state_ort[i]);
+            if (model->takes_sample_rate())
+                io_binding[i]->BindInput(input_node_names[2], sr_ort);
+            io_binding[i]->BindOutput(output_node_names[0], output_ort);
+            io_binding[i]->BindOutput(output_node_names[1], state_ort[i ^ 1]);
+        }
+        state_index = 0;
+    };
+
+    void reset_states()
+    {
+        VadIterator::reset_states();
+        std::memset(_stateN.data(), 0, _stateN.size() * sizeof(float));
+        state_index = 0;
+    };
+
+    void scale_state(float factor)
+    {
+        for (float &value : state_index == 0 ? _state : _stateN)
+            value *= factor;
+    };
+
+    void predict()
+    {
+        // Infer, the window is already in the bound input buffer and outputs land in the bound buffers
+        {
+            VAD_STAGE(stage_timers, stage_infer);
+            model->session().Run(run_options, *io_binding[state_index]);
+        }
+
+        // Output probability & update h,c recursively
+        float speech_prob = output[0];
+        // std::cout << "speech_prob = " << speech_prob << std::endl;
+        // stateN is already in the other state buffer, swap roles instead of copying
+        state_index ^= 1;
+
+        segment(speech_prob);
+    };
+
+private:
+    // Onnx model
+    // Inputs
+    Ort::Value input_ort{nullptr};
+    Ort::Value state_ort[2] = { Ort::Value{nullptr}, Ort::Value{nullptr} };
+    Ort::Value sr_ort{nullptr};
+    std::vector<float> _stateN;
+
+    // Outputs
+    std::vector<float> output;
+    Ort::Value output_ort{nullptr};
+    const int64_t output_node_dims[2] = {1, 1};
+
+    // Binding i reads state_ort[i] and writes state_ort[i ^ 1]
+    std::unique_ptr<Ort::IoBinding> io_binding[2];
+    Ort::RunOptions run_options{nullptr};
+    int state_index = 0;
+
+public:
+    // Construction
+    OnnxVadIterator(const std::string ModelPath,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_model(ModelPath, OnnxThreadingPolicy());
+    }
+
+    OnnxVadIterator(const std::string ModelPath, const OnnxThreadingPolicy &Policy,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_model(ModelPath, Policy);
+    }
+
+    OnnxVadIterator(std::shared_ptr<OnnxVadModel> Model,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s),
+        model(Model)
+    {
+        init_binding();
+    }
+};
+#elif !defined NATIVE
+#define NNCASE_DUMP_BIN 0
+// The kmodel bytes, loaded once and shared read-only. Every iterator still
+// needs its own interpreter, but it references these bytes instead of
+// holding a private copy of the weights.
+class NncaseVadModel
+{
+private:
+    std::unique_ptr<char[]> data_;
+    size_t size_ = 0;
+
+public:
+    gsl::span<const gsl::byte> buffer() const
+    {
+        return { reinterpret_cast<const gsl::byte *>(data_.get()), size_ };
+    };
+
+    // Construction
+    NncaseVadModel(const std::string& model_path)
+    {
+        std::ifstream ifs(model_path, std::ios::binary | std::ios::ate);
+        if (!ifs)
+            throw std::runtime_error("cannot open " + model_path);
+        size_ = static_cast<size_t>(ifs.tellg());
+        data_.reset(new char[size_]);
+        ifs.seekg(0, std::ios::beg);
+        ifs.read(data_.get(), size_);
+    }
+};
+
+class NncaseVadIterator: public VadIterator
+{
+private:
+    nncase::runtime::runtime_tensor create_tensor(nncase::typecode_t data_type, std::initializer_list<size_t> dims)
+    {
+        nncase::dims_t shape(dims.begin(), dims.end());
+        return nncase::runtime::host_runtime_tensor::create(data_type, shape, nncase::runtime::host_runtime_tensor::pool_shared).expect("cannot create tensor");
+    }
+
+    nncase::typecode_t parameter_typecode(size_t index)
+    {
+        auto type = entry_function_->parameter_type(index).expect("parameter type out of index");
+        auto ts_type = type.as<nncase::tensor_type>().expect("input is not a tensor type");
+        return ts_type->dtype()->typecode();
+    }
+
+    // Samples of the compiled input, -1 if the kmodel leaves it dynamic
+    int64_t parameter_length(size_t index)
+    {
+        auto type = entry_function_->parameter_type(index).expect("parameter type out of index");
+        auto ts_type = type.as<nncase::tensor_type>().expect("input is not a tensor type");
+        const nncase::shape_t &shape = ts_type->shape();
+        if (!shape.is_ranked() || shape.dims().empty() || !shape.back().is_fixed())
+            return -1;
+        return shape.back().fixed_value();
+    }
+
+    void init_model(std::shared_ptr<NncaseVadModel> Model)
+    {
+        model_ = Model;
+        interpreter_.load_model(model_->buffer(), false).unwrap_or_throw();
+        entry_function_ = interpreter_.entry_function().unwrap_or_throw();
+
+        // kmodels compiled from the bare window have no room for the context
+        if (parameter_length(0) == window_size_samples)
+            set_context_samples(0);
+
+        // Create all io tensors once, predict() only touches their mapped memory afterwards.
+        auto input_type = parameter_typecode(0);
+        auto state_type = parameter_typecode(1);
+        input_tensor_ = create_tensor(input_type, { static_cast<size_t>(input_node_dims[0]), static_cast<size_t>(input_node_dims[1]) });
+        sr_tensor_ = create_tensor(parameter_typecode(2), { static_cast<size_t>(sr_node_dims[0]) });
+        output_tensor_ = create_tensor(input_type, { static_cast<size_t>(input_node_dims[0]), 1 });
+        for (int i = 0; i < 2; i++)
+        {
+            state_tensors_[i] = create_tensor(state_type, { static_cast<size_t>(state_node_dims[0]), static_cast<size_t>(state_node_dims[1]), static_cast<size_t>(state_node_dims[2]) });
+            state_mapped_[i] = nncase::runtime::hrt::map(state_tensors_[i], nncase::runtime::map_read_write).unwrap_or_throw();
+            state_ptr_[i] = state_mapped_[i].buffer().as_span<float>().data();
+        }
+
+        input_mapped_ = nncase::runtime::hrt::map(input_tensor_, nncase::runtime::map_read_write).unwrap_or_throw();
+        input_ptr_ = input_mapped_.buffer().as_span<float>().data();
+        std::memset(input_ptr_, 0, context_samples * sizeof(float));
+        output_mapped_ = nncase::runtime::hrt::map(output_tensor_, nncase::runtime::map_read).unwrap_or_throw();
+        output_ptr_ = output_mapped_.buffer().as_span<float>().data();
+
+        {
+            auto sr_mapped = nncase::runtime::hrt::map(sr_tensor_, nncase::runtime::map_write).unwrap_or_throw();
+            sr_mapped.buffer().as_span<int64_t>().data()[0] = sr[0];
+        }
+        nncase::runtime::hrt::sync(sr_tensor_, nncase::runtime::sync_write_back, true).unwrap_or_throw();
+
+        inputs_ = { input_tensor_.impl(), state_tensors_[0].impl(), sr_tensor_.impl() };
+        outputs_ = nncase::tuple(std::in_place, std::vector<nncase::value_t> { output_tensor_.impl(), state_tensors_[1].impl() });
+        state_index_ = 0;
+    };
+
+    void reset_states()
+    {
+        VadIterator::reset_states();
+        for (int i = 0; i < 2; i++)
+        {
+            std::memset(state_ptr_[i], 0, size_state * sizeof(float));
+            nncase::runtime::hrt::sync(state_tensors_[i], nncase::runtime::sync_write_back, true).unwrap_or_throw();
+        }
+    };
+
+    void scale_state(float factor)
+    {
+        float *state = state_ptr_[state_index_];
+        for (unsigned int i = 0; i < size_state; i++)
+            state[i] *= factor;
+        nncase::runtime::hrt::sync(state_tensors_[state_index_], nncase::runtime::sync_write_back, true).unwrap_or_throw();
+    };
+
+#if NNCASE_DUMP_BIN
+    void dump_to_bin(const char *file_name, const char *buf, size_t size)
+    {
+        std::ofstream ofs(file_name, std::ios::out | std::ios::binary);
+        ofs.write(buf, size);
+        ofs.close();
+    }
+#endif
+    float *input_buffer()
+    {
+        return input_ptr_;
+    };
+
+    void predict()
+    {
+        // Infer
+#if NNCASE_DUMP_BIN
+        static size_t count = 0;
+#endif
+
+        // set input1, the window was written straight into the mapped input tensor
+        {
+            VAD_STAGE(stage_timers, stage_tensor);
+            nncase::runtime::hrt::sync(input_tensor_, nncase::runtime::sync_write_back, true).unwrap_or_throw();
+        }
+#if NNCASE_DUMP_BIN
+        char file_name[64] = "\0";
+        snprintf(file_name, sizeof(file_name) / sizeof(file_name[0]), "tmp/input_%08lu.bin", count);
+        dump_to_bin(file_name, reinterpret_cast<const char *>(input_ptr_), input_node_dims[1] * sizeof(float));
+#endif
+
+        // set input2, the state written by the last invoke feeds this one and the other buffer receives stateN
+        inputs_[1] = state_tensors_[state_index_].impl();
+        outputs_->fields()[1] = state_tensors_[state_index_ ^ 1].impl();
+#if NNCASE_DUMP_BIN
+        snprintf(file_name, sizeof(file_name) / sizeof(file_name[0]), "tmp/state_%08lu.bin", count);
+        dump_to_bin(file_name, reinterpret_cast<const char *>(state_ptr_[state_index_]), size_state * sizeof(float));
+#endif
+
+        // input3 (sr) is constant and was written in init_model
+#if NNCASE_DUMP_BIN
+        snprintf(file_name, sizeof(file_name) / sizeof(file_name[0]), "tmp/sr_%08lu.bin", count);
+        dump_to_bin(file_name, reinterpret_cast<const char *>(sr.data()), sizeof(int64_t));
+        count++;
+#endif
+
+        // Infer into the preallocated output tuple
+        {
+            VAD_STAGE(stage_timers, stage_infer);
+            entry_function_->invoke(inputs_, outputs_).unwrap_or_throw();
+        }
+
+        // output1
+        {
+            VAD_STAGE(stage_timers, stage_tensor);
+            nncase::runtime::hrt::sync(output_tensor_, nncase::runtime::sync_invalidate, true).unwrap_or_throw();
+        }
+        // Output probability & update h,c recursively
+        float speech_prob = output_ptr_[0];
+        // std::cout << "speech_prob = " << speech_prob << std::endl;
+
+        // output2, no copy: just swap the roles of the two state tensors
+        state_index_ ^= 1;
+
+        segment(speech_prob);
+    };
+
+private:
+    std::shared_ptr<NncaseVadModel> model_;
+    nncase::runtime::interpreter interpreter_;
+    nncase::runtime::runtime_function *entry_function_;
+
+    // Persistent io, see init_model
+    nncase::runtime::runtime_tensor input_tensor_;
+    nncase::runtime::runtime_tensor state_tensors_[2];
+    nncase::runtime::runtime_tensor sr_tensor_;
+    nncase::runtime::runtime_tensor output_tensor_;
+    nncase::runtime::mapped_buffer input_mapped_;
+    nncase::runtime::mapped_buffer state_mapped_[2];
+    nncase::runtime::mapped_buffer output_mapped_;
+    float *input_ptr_ = nullptr;
+    float *state_ptr_[2] = {};
+    float *output_ptr_ = nullptr;
+    std::vector<nncase::value_t> inputs_;
+    nncase::tuple outputs_;
+    int state_index_ = 0; // index of the state tensor fed to the next invoke
+
+public:
+    // Construction
+    NncaseVadIterator(const std::string ModelPath,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_model(std::make_shared<NncaseVadModel>(ModelPath));
+    }
+
+    NncaseVadIterator(std::shared_ptr<NncaseVadModel> Model,
+        int Sample_rate = 16000, int windows_frame_size = 32,
+        float Threshold = 0.5, int min_silence_duration_ms = 0,
+        int speech_pad_ms = 32, int min_speech_duration_ms = 32,
+        float max_speech_duration_s = std::numeric_limits<float>::infinity()): VadIterator(Sample_rate, windows_frame_size,
+        Threshold, min_silence_duration_ms, speech_pad_ms, min_speech_duration_ms, max_speech_duration_s)
+    {
+        init_model(Model);
+    }
+};
+#endif
+
+#endif  // SILERO_VAD_ITERATOR_H_
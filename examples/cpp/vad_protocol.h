@@ -0,0 +1,89 @@
+#ifndef SILERO_VAD_PROTOCOL_H_
+#define SILERO_VAD_PROTOCOL_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Framing between vad_server and its clients on a Unix stream socket. One
+// connection is one audio stream. Every message is a frame_header_t followed
+// by length bytes of payload, all little endian:
+//
+//   client -> server
+//     open   open_payload_t, first frame of a connection
+//     audio  PCM samples in the format given by open, any length
+//     end    no payload: the audio is over, the server flushes, sends the
+//            remaining events and done, then closes
+//   server -> client
+//     event  event_payload_t, one speech start or end
+//     done   no payload, after end
+//     error  message text, the server closes afterwards
+namespace vad_protocol
+{
+
+enum frame_type_t : uint32_t
+{
+    frame_open = 1,
+    frame_audio = 2,
+    frame_end = 3,
+    frame_event = 16,
+    frame_done = 17,
+    frame_error = 18,
+};
+
+enum sample_format_t : uint32_t
+{
+    format_s16 = 0,
+    format_f32 = 1,
+};
+
+struct frame_header_t
+{
+    uint32_t type;
+    uint32_t length; // payload bytes
+};
+
+struct open_payload_t
+{
+    uint32_t sample_rate;
+    uint32_t format; // sample_format_t
+};
+
+struct event_payload_t
+{
+    uint32_t type;     // vad_event_t::type_t, 0 start, 1 end
+    uint32_t reserved;
+    int64_t sample;    // boundary, in samples from the start of the stream
+    int64_t decided;   // samples the server had inferred when it decided, for latency
+};
+
+const uint32_t max_payload = 1 << 20;
+
+// Appends one frame to out
+inline void append_frame(std::vector<char> &out, uint32_t type, const void *payload, uint32_t length)
+{
+    frame_header_t header = { type, length };
+    size_t at = out.size();
+    out.resize(at + sizeof(header) + length);
+    std::memcpy(&out[at], &header, sizeof(header));
+    if (length > 0)
+        std::memcpy(&out[at + sizeof(header)], payload, length);
+}
+
+// Next complete frame in [data, data + size): returns the bytes it takes
+// (header included, 0 if it is not all there yet) and points payload at it
+inline size_t next_frame(const char *data, size_t size, frame_header_t &header, const char *&payload)
+{
+    if (size < sizeof(header))
+        return 0;
+    std::memcpy(&header, data, sizeof(header));
+    if (size - sizeof(header) < header.length)
+        return 0;
+    payload = data + sizeof(header);
+    return sizeof(header) + header.length;
+}
+
+}  // namespace vad_protocol
+
+#endif  // SILERO_VAD_PROTOCOL_H_
@@ -0,0 +1,412 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "vad_iterator.h"
+#include "batched_vad_engine.h"
+#if defined NATIVE
+#include "native_vad.h"
+#endif
+#include "vad_protocol.h"
+
+using namespace vad_protocol;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int)
+{
+    stop_requested = 1;
+}
+
+// VAD sidecar: every connection on the Unix socket is one stream with its own
+// state slot in a BatchedVadEngine over one shared model. A single thread
+// does all the I/O with epoll; after each wake-up, the windows completed by
+// all streams in it are inferred together in one batched invoke and the
+// events are queued to their clients.
+class VadServer
+{
+public:
+    void run()
+    {
+        std::vector<epoll_event> ready(256);
+        while (!stop_requested) {
+            int count = epoll_wait(epoll_fd, ready.data(), static_cast<int>(ready.size()),
+                accept_paused ? accept_retry_ms : -1);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string("epoll_wait: ") + strerror(errno));
+            }
+            if (count == 0 && accept_paused)
+                watch_listener(true); // the descriptors were held elsewhere, try again
+            for (int i = 0; i < count; i++) {
+                if (ready[i].data.fd == listen_fd) {
+                    accept_all();
+                    continue;
+                }
+                auto found = connections.find(ready[i].data.fd);
+                if (found == connections.end())
+                    continue;
+                connection_t &conn = *found->second;
+                if (ready[i].events & EPOLLIN)
+                    receive(conn);
+                if (!conn.dead && (ready[i].events & EPOLLOUT))
+                    send_pending(conn);
+                if (!conn.dead && (ready[i].events & (EPOLLERR | EPOLLHUP)) && !(ready[i].events & EPOLLIN))
+                    conn.dead = true;
+            }
+
+            // One invoke for every window completed in this round
+            if (engine.run() > 0)
+                invokes++;
+            rounds++;
+            for (connection_t *conn : touched) {
+                conn->touched = false;
+                if (!conn->dead)
+                    deliver_events(*conn);
+            }
+            touched.clear();
+            reap();
+        }
+    };
+
+    void print_stats() const
+    {
+        std::cout << "connections=" << accepted
+                  << " windows=" << windows
+                  << " rounds=" << rounds
+                  << " round_invokes=" << invokes
+                  << " windows_per_invoke=" << (invokes ? static_cast<double>(windows) / invokes : 0.0)
+                  << std::endl;
+#if defined VAD_STAGE_TIMERS
+        engine.get_stage_timers().dump_text(std::cout);
+#endif
+    };
+
+private:
+    struct connection_t
+    {
+        int fd;
+        int id = -1;          // engine stream, once opened
+        uint32_t format = format_s16;
+        std::vector<char> in; // received, not yet parsed
+        std::vector<char> out;
+        size_t out_sent = 0;
+        bool writing = false; // EPOLLOUT armed
+        std::vector<float> window;
+        size_t pending = 0;   // samples in window
+        int64_t samples = 0;  // received in total
+        bool closing = false; // close once out is sent
+        bool dead = false;
+        bool touched = false;
+        std::vector<vad_event_t> events;
+    };
+
+    // The listen socket is level-triggered: if accept4 fails while a connection
+    // is pending (no descriptors left), it stays readable and epoll_wait would
+    // spin, so it is taken out of the set until a connection is reaped or
+    // accept_retry_ms passes.
+    void accept_all()
+    {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    std::cerr << "accept: " << strerror(errno) << ", pausing new connections" << std::endl;
+                    watch_listener(false);
+                }
+                return;
+            }
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                std::cerr << "epoll_ctl: " << strerror(errno) << ", dropping a connection" << std::endl;
+                close(fd);
+                continue;
+            }
+            std::unique_ptr<connection_t> conn(new connection_t());
+            conn->fd = fd;
+            conn->window.resize(engine.window_samples());
+            connections[fd] = std::move(conn);
+            accepted++;
+        }
+    };
+
+    void receive(connection_t &conn)
+    {
+        char buf[64 * 1024];
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if (n == 0 && conn.closing && conn.out_sent < conn.out.size()) {
+            // Half-closed after end: only the answer is left to send
+            conn.writing = true;
+            epoll_event ev = {};
+            ev.events = EPOLLOUT;
+            ev.data.fd = conn.fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) != 0)
+                conn.dead = true;
+            return;
+        }
+        if (n <= 0) {
+            if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                conn.dead = true;
+            return;
+        }
+        if (conn.closing)
+            return;
+        conn.in.insert(conn.in.end(), buf, buf + n);
+
+        size_t used = 0;
+        frame_header_t header;
+        const char *payload;
+        while (!conn.closing) {
+            size_t size = next_frame(conn.in.data() + used, conn.in.size() - used, header, payload);
+            if (size == 0) {
+                if (conn.in.size() - used >= sizeof(header) && header.length > max_payload)
+                    fail(conn, "frame too long");
+                break;
+            }
+            used += size;
+            handle(conn, header, payload);
+        }
+        conn.in.erase(conn.in.begin(), conn.in.begin() + used);
+    };
+
+    void handle(connection_t &conn, const frame_header_t &header, const char *payload)
+    {
+        if (header.type == frame_open) {
+            open_payload_t open;
+            if (conn.id >= 0 || header.length != sizeof(open))
+                return fail(conn, "bad open");
+            std::memcpy(&open, payload, sizeof(open));
+            if (static_cast<int>(open.sample_rate) != engine.sample_rate())
+                return fail(conn, "sample rate must be " + std::to_string(engine.sample_rate()));
+            if (open.format != format_s16 && open.format != format_f32)
+                return fail(conn, "unknown sample format");
+            conn.format = open.format;
+            conn.id = engine.add_stream();
+        }
+        else if (header.type == frame_audio) {
+            size_t width = conn.format == format_s16 ? sizeof(int16_t) : sizeof(float);
+            if (conn.id < 0 || header.length % width != 0)
+                return fail(conn, "bad audio");
+            add_audio(conn, payload, header.length / width);
+        }
+        else if (header.type == frame_end) {
+            if (conn.id < 0)
+                return fail(conn, "end before open");
+            engine.finish_stream(conn.id, conn.samples);
+            deliver_events(conn);
+            append_frame(conn.out, frame_done, nullptr, 0);
+            conn.closing = true;
+            send_pending(conn);
+        }
+        else
+            fail(conn, "unknown frame");
+    };
+
+    void add_audio(connection_t &conn, const char *data, size_t count)
+    {
+        const size_t window = conn.window.size();
+        conn.samples += count;
+        while (count > 0) {
+            size_t take = std::min(count, window - conn.pending);
+            float *dst = conn.window.data() + conn.pending;
+            if (conn.format == format_f32)
+                std::memcpy(dst, data, take * sizeof(float));
+            else {
+                for (size_t i = 0; i < take; i++) {
+                    int16_t sample;
+                    std::memcpy(&sample, data + i * sizeof(int16_t), sizeof(sample));
+                    dst[i] = sample * (1.0f / 32768);
+                }
+            }
+            data += take * (conn.format == format_f32 ? sizeof(float) : sizeof(int16_t));
+            count -= take;
+            conn.pending += take;
+            if (conn.pending == window) {
+                // Runs the batch first if this stream already has a window in it
+                engine.push_window(conn.id, conn.window.data());
+                conn.pending = 0;
+                windows++;
+                if (!conn.touched) {
+                    conn.touched = true;
+                    touched.push_back(&conn);
+                }
+            }
+        }
+    };
+
+    void deliver_events(connection_t &conn)
+    {
+        conn.events.clear();
+        engine.take_events(conn.id, conn.events);
+        if (conn.events.empty())
+            return;
+        int64_t decided = engine.stream_samples(conn.id);
+        for (const vad_event_t &event : conn.events) {
+            event_payload_t payload = { static_cast<uint32_t>(event.type), 0, event.sample, decided };
+            append_frame(conn.out, frame_event, &payload, sizeof(payload));
+        }
+        send_pending(conn);
+    };
+
+    void fail(connection_t &conn, const std::string &message)
+    {
+        append_frame(conn.out, frame_error, message.data(), static_cast<uint32_t>(message.size()));
+        conn.closing = true;
+        send_pending(conn);
+    };
+
+    void send_pending(connection_t &conn)
+    {
+        while (conn.out_sent < conn.out.size()) {
+            ssize_t n = send(conn.fd, conn.out.data() + conn.out_sent, conn.out.size() - conn.out_sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                if (errno == EINTR)
+                    continue;
+                conn.dead = true;
+                return;
+            }
+            conn.out_sent += n;
+        }
+        bool drained = conn.out_sent == conn.out.size();
+        if (drained) {
+            conn.out.clear();
+            conn.out_sent = 0;
+            if (conn.closing)
+                conn.dead = true;
+        }
+        if (drained == conn.writing && !conn.dead) {
+            conn.writing = !drained;
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (conn.writing ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            ev.data.fd = conn.fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) != 0)
+                conn.dead = true;
+        }
+    };
+
+    // Stops or resumes polling the listen socket for new connections
+    void watch_listener(bool on)
+    {
+        epoll_event ev = {};
+        ev.events = on ? static_cast<uint32_t>(EPOLLIN) : 0u;
+        ev.data.fd = listen_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev) != 0)
+            throw std::runtime_error(std::string("epoll_ctl: ") + strerror(errno));
+        accept_paused = !on;
+    };
+
+    // Closes dead connections and frees their state slots, and accepts again
+    // once that has freed a descriptor
+    void reap()
+    {
+        bool closed = false;
+        for (auto it = connections.begin(); it != connections.end();) {
+            connection_t &conn = *it->second;
+            if (!conn.dead) {
+                ++it;
+                continue;
+            }
+            if (conn.id >= 0)
+                engine.remove_stream(conn.id);
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+            close(conn.fd);
+            it = connections.erase(it);
+            closed = true;
+        }
+        if (closed && accept_paused)
+            watch_listener(true);
+    };
+
+    BatchedVadEngine &engine;
+    std::string socket_path;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    std::unordered_map<int, std::unique_ptr<connection_t>> connections;
+    std::vector<connection_t *> touched; // pushed a window this round
+    bool accept_paused = false;          // listen socket out of the epoll set
+    int accept_retry_ms = 1000;
+
+    int64_t accepted = 0;
+    int64_t windows = 0;
+    int64_t rounds = 0;
+    int64_t invokes = 0; // at the end of a round, a stream sending two windows at once adds one more
+
+public:
+    // Construction, listens on Socket_path (an existing socket file is replaced)
+    VadServer(BatchedVadEngine &Engine, const std::string &Socket_path)
+        : engine(Engine), socket_path(Socket_path)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+            throw std::invalid_argument("socket path too long");
+        std::strcpy(addr.sun_path, socket_path.c_str());
+        unlink(socket_path.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+            || listen(listen_fd, 128) != 0)
+            throw std::runtime_error("cannot listen on " + socket_path + ": " + strerror(errno));
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd;
+        if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0)
+            throw std::runtime_error(std::string("cannot poll the listen socket: ") + strerror(errno));
+    };
+
+    ~VadServer()
+    {
+        for (auto &entry : connections)
+            close(entry.first);
+        close(epoll_fd);
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    };
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " socket_path model_file [max_batch] [sample_rate]" << std::endl;
+        return 1;
+    }
+    std::string path(argv[2]);
+    int max_batch = argc > 3 ? std::stoi(argv[3]) : 32;
+    int sample_rate = argc > 4 ? std::stoi(argv[4]) : 16000;
+
+#if defined ONNX
+    OnnxBatchedVadEngine engine(path, max_batch, sample_rate);
+#elif defined NATIVE
+    NativeBatchedVadEngine engine(path, max_batch, sample_rate);
+#else
+    NncaseBatchedVadEngine engine(path, max_batch, sample_rate);
+#endif
+
+    struct sigaction action = {};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    VadServer server(engine, argv[1]);
+    std::cout << "listening on " << argv[1] << std::endl;
+    server.run();
+    server.print_stats();
+    return 0;
+}
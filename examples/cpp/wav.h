@@ -17,12 +17,24 @@
 #define FRONTEND_WAV_H_
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <iostream>
 #include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 
 // #include "utils/log.h"
 
@@ -44,52 +56,642 @@ struct WavHeader {
   unsigned int data_size;
 };
 
-class WavReader {
+// Format codes of the fmt chunk; WAVE_FORMAT_EXTENSIBLE carries one of the
+// others in the first two bytes of its sub-format GUID
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatAlaw = 6;
+const uint16_t kFormatMulaw = 7;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+// PCM to float conversion of n samples, dst[i] = src[i] * scale
+inline void ConvertS16(const int16_t* src, float* dst, int64_t n, float scale) {
+  for (int64_t i = 0; i < n; ++i) dst[i] = static_cast<float>(src[i]) * scale;
+}
+
+inline void ConvertS32(const int32_t* src, float* dst, int64_t n, float scale) {
+  for (int64_t i = 0; i < n; ++i) dst[i] = static_cast<float>(src[i]) * scale;
+}
+
+// 8 bit PCM is unsigned, centered on 128
+inline void ConvertU8(const uint8_t* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i)
+    dst[i] = static_cast<float>(static_cast<int>(src[i]) - 128) * (1.0f / 128);
+}
+
+// Packed little endian 24 bit, shifted into the top of an int32 so it scales
+// like S32
+inline void ConvertS24(const uint8_t* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    uint32_t v = (static_cast<uint32_t>(src[3 * i]) << 8) |
+                 (static_cast<uint32_t>(src[3 * i + 1]) << 16) |
+                 (static_cast<uint32_t>(src[3 * i + 2]) << 24);
+    dst[i] = static_cast<float>(static_cast<int32_t>(v)) * (1.0f / 2147483648.0f);
+  }
+}
+
+inline void ConvertF64(const double* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+}
+
+// G.711 code words to 16 bit linear (ITU-T G.711, as in the reference
+// decoder), then to float through a 256 entry table
+inline int16_t AlawToLinear(uint8_t a) {
+  a ^= 0x55;
+  int t = (a & 0x0f) << 4;
+  int segment = (a & 0x70) >> 4;
+  if (segment == 0)
+    t += 8;
+  else
+    t = (t + 0x108) << (segment - 1);
+  return static_cast<int16_t>((a & 0x80) ? t : -t);
+}
+
+inline int16_t MulawToLinear(uint8_t u) {
+  u = ~u;
+  int t = (((u & 0x0f) << 3) + 0x84) << ((u & 0x70) >> 4);
+  return static_cast<int16_t>((u & 0x80) ? 0x84 - t : t - 0x84);
+}
+
+struct G711Tables {
+  float alaw[256];
+  float mulaw[256];
+  G711Tables() {
+    for (int i = 0; i < 256; ++i) {
+      alaw[i] = AlawToLinear(static_cast<uint8_t>(i)) * (1.0f / 32768);
+      mulaw[i] = MulawToLinear(static_cast<uint8_t>(i)) * (1.0f / 32768);
+    }
+  }
+};
+
+inline const G711Tables& G711() {
+  static const G711Tables tables;
+  return tables;
+}
+
+inline void ConvertTable(const uint8_t* src, float* dst, int64_t n,
+                         const float* table) {
+  for (int64_t i = 0; i < n; ++i) dst[i] = table[src[i]];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) inline void ConvertS16Avx2(
+    const int16_t* src, float* dst, int64_t n, float scale) {
+  const __m256 s = _mm256_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), s));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), s));
+  }
+  ConvertS16(src + i, dst + i, n - i, scale);
+}
+
+__attribute__((target("avx2"))) inline void ConvertS32Avx2(
+    const int32_t* src, float* dst, int64_t n, float scale) {
+  const __m256 s = _mm256_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), s));
+  }
+  ConvertS32(src + i, dst + i, n - i, scale);
+}
+
+__attribute__((target("avx2"))) inline void ConvertU8Avx2(
+    const uint8_t* src, float* dst, int64_t n) {
+  const __m256 s = _mm256_set1_ps(1.0f / 128);
+  const __m256i bias = _mm256_set1_epi32(128);
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m256i lo = _mm256_sub_epi32(_mm256_cvtepu8_epi32(v), bias);
+    __m256i hi = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), bias);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), s));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), s));
+  }
+  ConvertU8(src + i, dst + i, n - i);
+}
+
+// Four samples (12 bytes) per 128 bit lane, each shuffled into the top three
+// bytes of its 32 bit lane. The second load reads 4 bytes past the 8
+// samples, hence the 10 sample bound.
+__attribute__((target("avx2"))) inline void ConvertS24Avx2(
+    const uint8_t* src, float* dst, int64_t n) {
+  const __m256 s = _mm256_set1_ps(1.0f / 2147483648.0f);
+  const __m256i shuffle = _mm256_setr_epi8(
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  int64_t i = 0;
+  for (; i + 10 <= n; i += 8) {
+    const uint8_t* p = src + 3 * i;
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), s));
+  }
+  ConvertS24(src + 3 * i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void ConvertF64Avx2(
+    const double* src, float* dst, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i + 4));
+    _mm256_storeu_ps(dst + i, _mm256_set_m128(hi, lo));
+  }
+  ConvertF64(src + i, dst + i, n - i);
+}
+
+// G.711 through the table with gathers, 16 code words at a time
+__attribute__((target("avx2"))) inline void ConvertTableAvx2(
+    const uint8_t* src, float* dst, int64_t n, const float* table) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m256i lo = _mm256_cvtepu8_epi32(v);
+    __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8));
+    _mm256_storeu_ps(dst + i, _mm256_i32gather_ps(table, lo, 4));
+    _mm256_storeu_ps(dst + i + 8, _mm256_i32gather_ps(table, hi, 4));
+  }
+  ConvertTable(src + i, dst + i, n - i, table);
+}
+
+// Stereo s16 frames to two channels, or to their mean, in one pass: the
+// low halves of the 32 bit lanes are the left samples, the high halves the
+// right ones, so shifts sign-extend both without a shuffle
+inline void SplitS16x2(const int16_t* src, float* left, float* right, int64_t n,
+                       float scale) {
+  for (int64_t i = 0; i < n; ++i) {
+    if (left) left[i] = static_cast<float>(src[2 * i]) * scale;
+    if (right) right[i] = static_cast<float>(src[2 * i + 1]) * scale;
+  }
+}
+
+inline void DownmixS16x2(const int16_t* src, float* dst, int64_t n,
+                         float scale) {
+  for (int64_t i = 0; i < n; ++i)
+    dst[i] = (static_cast<float>(src[2 * i]) + src[2 * i + 1]) * (scale * 0.5f);
+}
+
+__attribute__((target("avx2"))) inline void SplitS16x2Avx2(
+    const int16_t* src, float* left, float* right, int64_t n, float scale) {
+  if (!left || !right) return SplitS16x2(src, left, right, n, scale);
+  const __m256 s = _mm256_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+    __m256i l = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+    __m256i r = _mm256_srai_epi32(v, 16);
+    _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_cvtepi32_ps(l), s));
+    _mm256_storeu_ps(right + i, _mm256_mul_ps(_mm256_cvtepi32_ps(r), s));
+  }
+  SplitS16x2(src + 2 * i, left + i, right + i, n - i, scale);
+}
+
+__attribute__((target("avx2"))) inline void DownmixS16x2Avx2(
+    const int16_t* src, float* dst, int64_t n, float scale) {
+  const __m256 s = _mm256_set1_ps(scale * 0.5f);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+    __m256i sum = _mm256_add_epi32(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16),
+                                   _mm256_srai_epi32(v, 16));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(sum), s));
+  }
+  DownmixS16x2(src + 2 * i, dst + i, n - i, scale);
+}
+
+inline bool HasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+#endif
+
+// Maps the whole file read-only and exposes the samples of the "data" chunk
+// in place. Nothing is converted up front: Read() turns any range of samples
+// into float when it is asked for, so memory does not grow with file length
+// (the kernel pages the mapping in and out as needed).
+class MappedWavReader {
  public:
-  WavReader() : data_(nullptr) {}
-  explicit WavReader(const std::string& filename) { Open(filename); }
+  MappedWavReader() {}
+  explicit MappedWavReader(const std::string& filename) { Open(filename); }
+  MappedWavReader(const MappedWavReader&) = delete;
+  MappedWavReader& operator=(const MappedWavReader&) = delete;
 
   bool Open(const std::string& filename) {
-    FILE* fp = fopen(filename.c_str(), "rb"); //文件读取
-    if (NULL == fp) {
-      std::cout << "Error in read " << filename;
+    Close();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fprintf(stderr, "Error in read %s\n", filename.c_str());
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 12) {
+      close(fd);
+      fprintf(stderr, "WaveData: %s is too short to be a wav file.\n",
+              filename.c_str());
+      return false;
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file referenced
+    if (map == MAP_FAILED) {
+      map_size_ = 0;
+      fprintf(stderr, "Error in mmap %s\n", filename.c_str());
       return false;
     }
+    map_ = static_cast<const char*>(map);
+    madvise(map, map_size_, MADV_SEQUENTIAL);
 
-    WavHeader header;
-    fread(&header, 1, sizeof(header), fp);
-    if (header.fmt_size < 16) {
-      printf("WaveData: expect PCM format data "
-              "to have fmt chunk of at least size 16.\n");
+    // RF64 (and BW64, its broadcast twin) is RIFF past 4 GB: the 32 bit
+    // sizes are 0xFFFFFFFF and the real ones are in a "ds64" chunk
+    const bool rf64 =
+        0 == strncmp(map_, "RF64", 4) || 0 == strncmp(map_, "BW64", 4);
+    if ((!rf64 && 0 != strncmp(map_, "RIFF", 4)) ||
+        0 != strncmp(map_ + 8, "WAVE", 4)) {
+      fprintf(stderr, "WaveData: %s is not a RIFF/WAVE file.\n",
+              filename.c_str());
+      Close();
       return false;
-    } else if (header.fmt_size > 16) {
-      int offset = 44 - 8 + header.fmt_size - 16;
-      fseek(fp, offset, SEEK_SET);
-      fread(header.data, 8, sizeof(char), fp);
-    }
-    // check "riff" "WAVE" "fmt " "data"
-
-    // Skip any sub-chunks between "fmt" and "data".  Usually there will
-    // be a single "fact" sub chunk, but on Windows there can also be a
-    // "list" sub chunk.
-    while (0 != strncmp(header.data, "data", 4)) {
-      // We will just ignore the data in these chunks.
-      fseek(fp, header.data_size, SEEK_CUR);
-      // read next sub chunk
-      fread(header.data, 8, sizeof(char), fp);
-    }
-
-    if (header.data_size == 0) {
-        int offset = ftell(fp);
-        fseek(fp, 0, SEEK_END);
-        header.data_size = ftell(fp) - offset;
-        fseek(fp, offset, SEEK_SET);
-    }
-
-    num_channel_ = header.channels;
-    sample_rate_ = header.sample_rate;
-    bits_per_sample_ = header.bit;
-    int num_data = header.data_size / (bits_per_sample_ / 8);
+    }
+
+    // Walk the sub-chunks: "fmt " describes the samples, "data" holds them,
+    // anything else ("fact", "LIST", ...) is skipped.
+    bool has_fmt = false;
+    uint64_t ds64_data_size = 0;
+    size_t offset = 12;
+    while (offset + 8 <= map_size_) {
+      const char* id = map_ + offset;
+      uint32_t size;
+      memcpy(&size, map_ + offset + 4, 4);
+      offset += 8;
+      if (0 == strncmp(id, "fmt ", 4)) {
+        if (size < 16 || offset + 16 > map_size_) {
+          fprintf(stderr,
+                  "WaveData: expect PCM format data "
+                  "to have fmt chunk of at least size 16.\n");
+          Close();
+          return false;
+        }
+        memcpy(&format_, map_ + offset, 2);
+        memcpy(&num_channel_, map_ + offset + 2, 2);
+        memcpy(&sample_rate_, map_ + offset + 4, 4);
+        memcpy(&bits_per_sample_, map_ + offset + 14, 2);
+        if (format_ == kFormatExtensible && !ReadSubFormat(offset, size)) {
+          fprintf(stderr, "WaveData: bad WAVE_FORMAT_EXTENSIBLE fmt chunk.\n");
+          Close();
+          return false;
+        }
+        has_fmt = true;
+      } else if (0 == strncmp(id, "ds64", 4) && size >= 24 &&
+                 offset + 24 <= map_size_) {
+        memcpy(&ds64_data_size, map_ + offset + 8, 8);
+      } else if (0 == strncmp(id, "data", 4)) {
+        // A size of 0 (or one past the end) comes from writers that could
+        // not seek back, the samples then run to the end of the file.
+        uint64_t data_size = size;
+        if (rf64 && size == 0xFFFFFFFF) data_size = ds64_data_size;
+        data_ = map_ + offset;
+        data_size_ = map_size_ - offset;
+        if (data_size != 0 && data_size < data_size_) data_size_ = data_size;
+        break;
+      }
+      offset += size + (size & 1);
+    }
+
+    if (!has_fmt || data_ == nullptr || num_channel_ == 0 || !SelectCodec()) {
+      fprintf(stderr,
+              "WaveData: unsupported format %d with %d bits per sample.\n",
+              format_, bits_per_sample_);
+      Close();
+      return false;
+    }
+    num_data_ = data_size_ / (bits_per_sample_ / 8);
+    num_samples_ = num_data_ / num_channel_;
+    return true;
+  }
+
+  void Close() {
+    if (map_ != nullptr) munmap(const_cast<char*>(map_), map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+    data_ = nullptr;
+    data_size_ = 0;
+    num_data_ = num_samples_ = 0;
+  }
+
+  ~MappedWavReader() { Close(); }
+
+  // Converts count interleaved samples starting at sample offset into dst,
+  // returns how many were available. Integer PCM comes out in [-1, 1).
+  int64_t Read(int64_t offset, int64_t count, float* dst) const {
+    if (offset < 0 || offset >= num_data_) return 0;
+    if (count > num_data_ - offset) count = num_data_ - offset;
+    const uint8_t* src =
+        reinterpret_cast<const uint8_t*>(data_) + offset * (bits_per_sample_ / 8);
+    switch (codec_) {
+      case kU8:
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertU8Avx2(src, dst, count);
+          break;
+        }
+#endif
+        ConvertU8(src, dst, count);
+        break;
+      case kS16:
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertS16Avx2(reinterpret_cast<const int16_t*>(src), dst, count,
+                         1.0f / 32768);
+          break;
+        }
+#endif
+        ConvertS16(reinterpret_cast<const int16_t*>(src), dst, count,
+                   1.0f / 32768);
+        break;
+      case kS24:
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertS24Avx2(src, dst, count);
+          break;
+        }
+#endif
+        ConvertS24(src, dst, count);
+        break;
+      case kS32:
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertS32Avx2(reinterpret_cast<const int32_t*>(src), dst, count,
+                         1.0f / 2147483648.0f);
+          break;
+        }
+#endif
+        ConvertS32(reinterpret_cast<const int32_t*>(src), dst, count,
+                   1.0f / 2147483648.0f);
+        break;
+      case kF32:
+        memcpy(dst, src, count * sizeof(float));
+        break;
+      case kF64:
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertF64Avx2(reinterpret_cast<const double*>(src), dst, count);
+          break;
+        }
+#endif
+        ConvertF64(reinterpret_cast<const double*>(src), dst, count);
+        break;
+      case kAlaw:
+      case kMulaw: {
+        const float* table = codec_ == kAlaw ? G711().alaw : G711().mulaw;
+#if defined(__x86_64__) || defined(__i386__)
+        if (HasAvx2()) {
+          ConvertTableAvx2(src, dst, count, table);
+          break;
+        }
+#endif
+        ConvertTable(src, dst, count, table);
+        break;
+      }
+    }
+    return count;
+  }
+
+  // Splits count frames (a sample of every channel) from frame offset into
+  // dst[channel], a null dst skipping its channel, straight from the mapped
+  // PCM; returns how many frames were available.
+  int64_t ReadChannels(int64_t offset, int64_t count, float* const* dst) const {
+    if (offset < 0 || offset >= num_samples_) return 0;
+    if (count > num_samples_ - offset) count = num_samples_ - offset;
+    if (num_channel_ == 1) return dst[0] ? Read(offset, count, dst[0]) : count;
+#if defined(__x86_64__) || defined(__i386__)
+    if (IsStereoS16() && HasAvx2()) {
+      SplitS16x2Avx2(reinterpret_cast<const int16_t*>(data_) + 2 * offset,
+                     dst[0], dst[1], count, 1.0f / 32768);
+      return count;
+    }
+#endif
+    if (IsStereoS16()) {
+      SplitS16x2(reinterpret_cast<const int16_t*>(data_) + 2 * offset, dst[0],
+                 dst[1], count, 1.0f / 32768);
+      return count;
+    }
+    // Other layouts convert a block at a time through Read(), on the stack
+    float stack[kBlock];
+    std::vector<float> heap;
+    float* block = stack;
+    int64_t frames = kBlock / num_channel_;
+    if (frames == 0) {  // more channels than a block holds
+      heap.resize(num_channel_);
+      block = heap.data();
+      frames = 1;
+    }
+    for (int64_t done = 0; done < count;) {
+      int64_t n = std::min(frames, count - done);
+      Read((offset + done) * num_channel_, n * num_channel_, block);
+      for (int c = 0; c < num_channel_; ++c) {
+        if (!dst[c]) continue;
+        for (int64_t i = 0; i < n; ++i)
+          dst[c][done + i] = block[i * num_channel_ + c];
+      }
+      done += n;
+    }
+    return count;
+  }
+
+  // Mean of all channels of count frames from frame offset into dst, in the
+  // same single pass; returns how many frames were available.
+  int64_t ReadDownmix(int64_t offset, int64_t count, float* dst) const {
+    if (offset < 0 || offset >= num_samples_) return 0;
+    if (count > num_samples_ - offset) count = num_samples_ - offset;
+    if (num_channel_ == 1) return Read(offset, count, dst);
+    if (IsStereoS16()) {
+      const int16_t* src = reinterpret_cast<const int16_t*>(data_) + 2 * offset;
+#if defined(__x86_64__) || defined(__i386__)
+      if (HasAvx2()) {
+        DownmixS16x2Avx2(src, dst, count, 1.0f / 32768);
+        return count;
+      }
+#endif
+      DownmixS16x2(src, dst, count, 1.0f / 32768);
+      return count;
+    }
+    float stack[kBlock];
+    std::vector<float> heap;
+    float* block = stack;
+    int64_t frames = kBlock / num_channel_;
+    if (frames == 0) {  // more channels than a block holds
+      heap.resize(num_channel_);
+      block = heap.data();
+      frames = 1;
+    }
+    const float mean = 1.0f / num_channel_;
+    for (int64_t done = 0; done < count;) {
+      int64_t n = std::min(frames, count - done);
+      Read((offset + done) * num_channel_, n * num_channel_, block);
+      for (int64_t i = 0; i < n; ++i) {
+        float sum = 0;
+        for (int c = 0; c < num_channel_; ++c) sum += block[i * num_channel_ + c];
+        dst[done + i] = sum * mean;
+      }
+      done += n;
+    }
+    return count;
+  }
+
+  // Drops the pages behind samples [offset, offset + count) from memory once
+  // they have been read, they are paged in again from the file if needed.
+  void Release(int64_t offset, int64_t count) const {
+    if (offset < 0 || count <= 0 || offset >= num_data_) return;
+    if (count > num_data_ - offset) count = num_data_ - offset;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t bytes = bits_per_sample_ / 8;
+    size_t begin = (data_ - map_) + offset * bytes;
+    size_t end = begin + count * bytes;
+    begin = (begin + page - 1) / page * page;  // only whole pages
+    end = end / page * page;
+    if (end > begin)
+      madvise(const_cast<char*>(map_) + begin, end - begin, MADV_DONTNEED);
+  }
+
+  int num_channel() const { return num_channel_; }
+  int sample_rate() const { return sample_rate_; }
+  int bits_per_sample() const { return bits_per_sample_; }
+  // The fmt chunk's format code, the sub-format's for WAVE_FORMAT_EXTENSIBLE
+  int format() const { return format_; }
+  int64_t num_samples() const { return num_samples_; }
+  // Interleaved samples of all channels
+  int64_t num_data() const { return num_data_; }
+
+  // Raw little endian samples of the data chunk, zero-copy
+  const void* pcm() const { return data_; }
+  size_t pcm_size() const { return data_size_; }
+
+ private:
+  // How Read() decodes the data chunk
+  enum Codec { kU8, kS16, kS24, kS32, kF32, kF64, kAlaw, kMulaw };
+
+  bool SelectCodec() {
+    switch (format_) {
+      case kFormatPcm:
+        if (bits_per_sample_ == 8) codec_ = kU8;
+        else if (bits_per_sample_ == 16) codec_ = kS16;
+        else if (bits_per_sample_ == 24) codec_ = kS24;
+        else if (bits_per_sample_ == 32) codec_ = kS32;
+        else return false;
+        return true;
+      case kFormatFloat:
+        if (bits_per_sample_ == 32) codec_ = kF32;
+        else if (bits_per_sample_ == 64) codec_ = kF64;
+        else return false;
+        return true;
+      case kFormatAlaw:
+      case kFormatMulaw:
+        codec_ = format_ == kFormatAlaw ? kAlaw : kMulaw;
+        return bits_per_sample_ == 8;
+      default:
+        return false;
+    }
+  }
+
+  // WAVE_FORMAT_EXTENSIBLE: the format is the first two bytes of the
+  // sub-format GUID, which otherwise is the fixed KSDATAFORMAT_SUBTYPE tail.
+  // Samples are left justified in their container, so a 24 in 32 bit file
+  // reads as S32 whatever its valid bits.
+  bool ReadSubFormat(size_t offset, uint32_t size) {
+    static const unsigned char kGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10,
+                                                0x00, 0x80, 0x00, 0x00, 0xAA,
+                                                0x00, 0x38, 0x9B, 0x71};
+    if (size < 40 || offset + 40 > map_size_) return false;
+    if (0 != memcmp(map_ + offset + 26, kGuidTail, sizeof(kGuidTail)))
+      return false;
+    memcpy(&format_, map_ + offset + 24, 2);
+    return true;
+  }
+
+  bool IsStereoS16() const {
+    return num_channel_ == 2 && codec_ == kS16;
+  }
+
+  static const int64_t kBlock = 1024;  // floats converted at a time
+  const char* map_ = nullptr;
+  size_t map_size_ = 0;
+  const char* data_ = nullptr;
+  size_t data_size_ = 0;
+  uint16_t format_ = 0;
+  Codec codec_ = kS16;
+  uint16_t num_channel_ = 0;
+  uint32_t sample_rate_ = 0;
+  uint16_t bits_per_sample_ = 0;
+  int64_t num_data_ = 0;
+  int64_t num_samples_ = 0;  // sample points per channel
+};
+
+// One channel of a MappedWavReader, or the mean of all of them, as the single
+// channel reader VadIterator::process() and ResampledReader take. Offsets and
+// counts are in frames; a mono file is read as it is.
+class WavChannelReader {
+ public:
+  static const int kDownmix = -1;
+
+  explicit WavChannelReader(const MappedWavReader& reader, int channel = kDownmix)
+      : reader_(reader), channel_(channel) {
+    if (channel_ < kDownmix || channel_ >= reader.num_channel()) channel_ = kDownmix;
+  }
+
+  int64_t Read(int64_t offset, int64_t count, float* dst) const {
+    if (channel_ == kDownmix) return reader_.ReadDownmix(offset, count, dst);
+    // Targets per call, several threads may read the same reader at once
+    float* stack[kStackChannels] = {};
+    std::vector<float*> heap;
+    float** targets = stack;
+    if (reader_.num_channel() > kStackChannels) {
+      heap.assign(reader_.num_channel(), nullptr);
+      targets = heap.data();
+    }
+    targets[channel_] = dst;
+    return reader_.ReadChannels(offset, count, targets);
+  }
+
+  void Release(int64_t offset, int64_t count) const {
+    reader_.Release(offset * reader_.num_channel(), count * reader_.num_channel());
+  }
+
+  int channel() const { return channel_; }
+  int sample_rate() const { return reader_.sample_rate(); }
+  int64_t num_samples() const { return reader_.num_samples(); }
+
+ private:
+  const MappedWavReader& reader_;
+  int channel_;
+  static const int kStackChannels = 32;
+};
+
+// Whole file converted to float in memory, built on MappedWavReader. The
+// channels are split into planes, so data() is the first channel and
+// channel(c) any other.
+class WavReader {
+ public:
+  WavReader() : data_(nullptr) {}
+  explicit WavReader(const std::string& filename) : data_(nullptr) {
+    Open(filename);
+  }
+
+  bool Open(const std::string& filename) {
+    MappedWavReader reader;
+    if (!reader.Open(filename)) return false;
+
+    num_channel_ = reader.num_channel();
+    sample_rate_ = reader.sample_rate();
+    bits_per_sample_ = reader.bits_per_sample();
+    int64_t num_data = reader.num_data();
+    delete[] data_;
     data_ = new float[num_data]; // Create 1-dim array
     num_samples_ = num_data / num_channel_;
 
@@ -97,79 +699,37 @@ class WavReader {
     std::cout << "sample_rate_    :" << sample_rate_ << std::endl;
     std::cout << "bits_per_sample_:" << bits_per_sample_ << std::endl;
     std::cout << "num_samples     :" << num_data << std::endl;
-    std::cout << "num_data_size   :" << header.data_size << std::endl;
-
-    switch (bits_per_sample_) {
-        case 8: {
-            char sample;
-            for (int i = 0; i < num_data; ++i) {
-                fread(&sample, 1, sizeof(char), fp);
-                data_[i] = static_cast<float>(sample) / 32768;
-            }
-            break;
-        }
-        case 16: {
-            int16_t sample;
-            for (int i = 0; i < num_data; ++i) {
-                fread(&sample, 1, sizeof(int16_t), fp);
-                data_[i] = static_cast<float>(sample) / 32768;
-            }
-            break;
-        }
-        case 32:
-        {
-            if (header.format == 1) //S32
-            {
-                int sample;
-                for (int i = 0; i < num_data; ++i) {
-                    fread(&sample, 1, sizeof(int), fp);
-                    data_[i] = static_cast<float>(sample) / 32768;
-                }
-            }
-            else if (header.format == 3) // IEEE-float
-            {
-                float sample;
-                for (int i = 0; i < num_data; ++i) {
-                    fread(&sample, 1, sizeof(float), fp);
-                    data_[i] = static_cast<float>(sample);
-                }
-            }
-            else {
-                printf("unsupported quantization bits\n");
-            }
-            break;
-        }
-        default:
-            printf("unsupported quantization bits\n");
-            break;
-    }
+    std::cout << "num_data_size   :" << reader.pcm_size() << std::endl;
 
-    fclose(fp);
+    std::vector<float*> planes(num_channel_);
+    for (int c = 0; c < num_channel_; ++c) planes[c] = data_ + c * num_samples_;
+    reader.ReadChannels(0, num_samples_, planes.data());
     return true;
   }
 
   int num_channel() const { return num_channel_; }
   int sample_rate() const { return sample_rate_; }
   int bits_per_sample() const { return bits_per_sample_; }
-  int num_samples() const { return num_samples_; }
+  int64_t num_samples() const { return num_samples_; }
 
   ~WavReader() {
     delete[] data_;
   }
 
   const float* data() const { return data_; }
+  const float* channel(int c) const { return data_ + c * num_samples_; }
 
  private:
   int num_channel_;
   int sample_rate_;
   int bits_per_sample_;
-  int num_samples_;  // sample points per channel
+  int64_t num_samples_;  // sample points per channel
   float* data_;
 };
 
 class WavWriter {
  public:
-  WavWriter(const float* data, int num_samples, int num_channel,
+  WavWriter(const float* data, int64_t num_samples, int num_channel,
             int sample_rate, int bits_per_sample)
       : data_(data),
         num_samples_(num_samples),
@@ -198,11 +758,12 @@ class WavWriter {
 
     fwrite(&header, 1, sizeof(header), fp);
 
-    for (int i = 0; i < num_samples_; ++i) {
+    for (int64_t i = 0; i < num_samples_; ++i) {
       for (int j = 0; j < num_channel_; ++j) {
         switch (bits_per_sample_) {
           case 8: {
-            char sample = static_cast<char>(data_[i * num_channel_ + j]);
+            uint8_t sample = static_cast<uint8_t>(
+                static_cast<int>(data_[i * num_channel_ + j]) + 128);
             fwrite(&sample, 1, sizeof(sample), fp);
             break;
           }
@@ -224,7 +785,7 @@ class WavWriter {
 
  private:
   const float* data_;
-  int num_samples_;  // total float points in data_
+  int64_t num_samples_;  // total float points in data_
   int num_channel_;
   int sample_rate_;
   int bits_per_sample_;
@@ -0,0 +1,127 @@
+// Benchmark suite runner for the libtorch model, same JSON lines as
+// `vad_bench suite` of the other backends (see ../cpp/bench_suite.h).
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+#include <torch/script.h>
+
+// The readers and segmentation of ../cpp, not the wav.h of this directory.
+// Only the model-less VadIterator is used, NATIVE keeps the runtime headers out.
+#define NATIVE
+#include "../cpp/wav.h"
+#include "../cpp/vad_iterator.h"
+#include "../cpp/bench_suite.h"
+
+// Every window through forward(x, sr) of the jit model, which keeps its own
+// state and context, repeated until at least min_seconds went through
+static bench::suite_result_t run(torch::jit::script::Module &model, const std::string &model_path, int sample_rate,
+	const std::string &input, const std::vector<float> &audio, double min_seconds)
+{
+	bench::suite_result_t result;
+	result.backend = "libtorch";
+	result.model = bench::base_name(model_path);
+	result.sample_rate = sample_rate;
+	result.input = input;
+	try {
+		torch::NoGradGuard no_grad;
+		const int window = sample_rate == 16000 ? 512 : 256;
+		const size_t windows = audio.size() / window;
+		if (windows == 0)
+			throw std::invalid_argument("audio shorter than a window");
+		result.window_samples = window;
+
+		auto infer = [&](size_t w) {
+			torch::Tensor chunk = torch::from_blob(const_cast<float*>(&audio[w * window]), {1, window}, torch::kFloat32);
+			std::vector<torch::jit::IValue> inputs;
+			inputs.push_back(chunk);
+			inputs.push_back(sample_rate);
+			return model.forward(inputs).toTensor().item<float>();
+		};
+
+		// Warm-up, so lazy allocations of the runtime are not counted
+		for (size_t w = 0; w < std::min<size_t>(windows, 32); w++)
+			infer(w);
+		model.run_method("reset_states");
+
+		const size_t rounds = std::max<size_t>(1, static_cast<size_t>(std::ceil(min_seconds * sample_rate / (windows * window))));
+		result.per_window_us.reserve(rounds * windows);
+		ProbTrack track;
+		track.sample_rate = sample_rate;
+		track.window_size_samples = window;
+		track.audio_length_samples = static_cast<int64_t>(rounds * windows * window);
+		track.probs.resize(rounds * windows);
+		uint64_t allocs = bench::alloc_count.load();
+		uint64_t bytes = bench::alloc_bytes.load();
+		for (size_t round = 0; round < rounds; round++) {
+			for (size_t w = 0; w < windows; w++) {
+				auto start = std::chrono::steady_clock::now();
+				track.probs[round * windows + w] = infer(w);
+				result.per_window_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+			}
+		}
+		result.allocs = bench::alloc_count.load() - allocs;
+		result.alloc_bytes = bench::alloc_bytes.load() - bytes;
+		result.audio_s = static_cast<double>(rounds * windows * window) / sample_rate;
+
+		// Speeches as the other backends count them, by the same segmentation
+		// with its default parameters
+		VadIterator segmenter(sample_rate);
+		segmenter.process(track);
+		result.speeches = static_cast<int64_t>(segmenter.get_speech_timestamps().size());
+	}
+	catch (const std::invalid_argument &e) {
+		result.skipped = e.what();
+	}
+	catch (const std::exception &e) {
+		result.error = e.what();
+	}
+	return result;
+}
+
+int main(int argc, char* argv[]) {
+
+	if (argc < 2 || argc > 4) {
+		std::cerr << "Usage : " << argv[0] << " <wav.path,...|synthetic> [model.jit] [min_seconds]" << std::endl;
+		return 1;
+	}
+	std::string model_path = argc > 2 ? argv[2] : "../../src/silero_vad/data/silero_vad.jit";
+	double min_seconds = argc > 3 ? std::stod(argv[3]) : 60.0;
+
+	torch::jit::script::Module model = torch::jit::load(model_path);
+	model.eval();
+
+	struct wav_input_t {
+		std::string name;
+		int sample_rate;
+		std::vector<float> audio;
+	};
+	std::vector<wav_input_t> wavs;
+	for (const std::string &file : bench::split_list(argv[1])) {
+		if (file == "synthetic")
+			continue;
+		// Multichannel files are downmixed, as in vad_bench
+		wav::MappedWavReader wav_file(file);
+		wav::WavChannelReader reader(wav_file);
+		wavs.push_back({bench::base_name(file), reader.sample_rate(), std::vector<float>(reader.num_samples())});
+		reader.Read(0, wavs.back().audio.size(), wavs.back().audio.data());
+	}
+
+	int failed = 0;
+	for (int sample_rate : {8000, 16000}) {
+		std::vector<bench::suite_result_t> results;
+		results.push_back(run(model, model_path, sample_rate, "synthetic", bench::synthetic_audio(sample_rate, 30), min_seconds));
+		for (const wav_input_t &wav : wavs) {
+			if (wav.sample_rate == sample_rate)
+				results.push_back(run(model, model_path, sample_rate, wav.name, wav.audio, min_seconds));
+		}
+		for (const bench::suite_result_t &result : results) {
+			failed += !result.error.empty();
+			std::cout << bench::format(result) << std::endl;
+		}
+	}
+	return failed > 0 ? 1 : 0;
+}